@@ -0,0 +1,226 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_ALLOCATOR_HPP
+#define CLS_ALLOCATOR_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include "cls_defs.h"
+
+#if defined __linux__
+#  include <sys/mman.h>
+#endif
+
+_CLS_BEGIN
+//////////////////////////////////////////////////////////////////////////////////////////
+// Allocator adaptor that default-initializes instead of value-initializing, so that
+// resize() of a container of trivial type doesn't clear the new elements.
+template<typename T, typename A = allocator<T>>
+class DefaultInitAllocator : public A {
+    using Traits = allocator_traits<A>;
+
+public:
+    template<typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U, typename Traits::template rebind_alloc<U>>;
+    };
+
+    using A::A;
+    DefaultInitAllocator() = default;
+    DefaultInitAllocator(const A& alloc) : A(alloc) {}
+
+    template<typename U>
+    void construct(U* ptr) noexcept(is_nothrow_default_constructible<U>::value) {
+        ::new(static_cast<void*>(ptr)) U;
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* ptr, Args&&... args) {
+        Traits::construct(static_cast<A&>(*this), ptr, forward<Args>(args)...);
+    }
+};
+
+template<typename T, typename A, typename U, typename B>
+inline bool operator==(const DefaultInitAllocator<T, A>& left, const DefaultInitAllocator<U, B>& right)
+{
+    return static_cast<const A&>(left) == static_cast<const B&>(right);
+}
+
+template<typename T, typename A, typename U, typename B>
+inline bool operator!=(const DefaultInitAllocator<T, A>& left, const DefaultInitAllocator<U, B>& right)
+{
+    return !(left == right);
+}
+
+namespace detail {
+inline void* alignedAlloc(size_t size, size_t align)
+{
+#ifdef _MSC_VER
+    auto ptr = _aligned_malloc(size, align);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, align, size) != 0) ptr = nullptr;
+#endif
+    if (!ptr) throw bad_alloc();
+    return ptr;
+}
+
+inline void alignedFree(void* ptr)
+{
+#ifdef _MSC_VER
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+} // End namespace detail
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Allocate memory aligned to Align bytes, Align must be a power of two
+template<typename T, size_t Align = 64>
+class AlignedAllocator {
+    static_assert(Align >= alignof(T) && (Align & (Align - 1)) == 0,
+                  "Alignment must be a power of two and not less than alignof(T)");
+
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(detail::alignedAlloc(max<size_t>(n * sizeof(T), 1), Align));
+    }
+
+    void deallocate(T* ptr, size_t) noexcept {
+        detail::alignedFree(ptr);
+    }
+};
+
+template<typename T, typename U, size_t Align>
+inline bool operator==(const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>&)
+{
+    return true;
+}
+
+template<typename T, typename U, size_t Align>
+inline bool operator!=(const AlignedAllocator<T, Align>&, const AlignedAllocator<U, Align>&)
+{
+    return false;
+}
+
+template<typename T>
+using PageAlignedAllocator = AlignedAllocator<T, 4096>;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Back large allocations with 2 MB huge pages to cut TLB misses on big buffers.
+// On Linux it tries explicit huge pages (MAP_HUGETLB) first and falls back to a 2 MB
+// aligned anonymous mapping advised for transparent huge pages. Allocations below
+// 2 MB and other platforms use page aligned heap memory. Fresh pages are zero filled
+// by the kernel only when first touched.
+template<typename T>
+class HugePageAllocator {
+    static const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind { using other = HugePageAllocator<U>; };
+
+    HugePageAllocator() = default;
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        auto size = max<size_t>(n * sizeof(T), 1);
+#if defined __linux__
+        if (size >= HUGE_PAGE_SIZE) return static_cast<T*>(mapHugePages(roundUp(size)));
+#endif
+        return static_cast<T*>(detail::alignedAlloc(size, 4096));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+#if defined __linux__
+        auto size = n * sizeof(T);
+        if (size >= HUGE_PAGE_SIZE) {
+            munmap(ptr, roundUp(size));
+            return;
+        }
+#endif
+        detail::alignedFree(ptr);
+    }
+
+private:
+    static size_t roundUp(size_t size) {
+        return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    }
+
+#if defined __linux__
+    static void* mapHugePages(size_t size) {
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#  ifdef MAP_HUGETLB
+        auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) return ptr;
+#  endif
+        // Over-map by one huge page and trim both ends to get a 2 MB aligned range
+        auto raw = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (raw == MAP_FAILED) throw bad_alloc();
+        auto addr    = reinterpret_cast<uintptr_t>(raw);
+        auto aligned = (addr + HUGE_PAGE_SIZE - 1) & ~uintptr_t(HUGE_PAGE_SIZE - 1);
+        if (aligned != addr) munmap(raw, aligned - addr);
+        auto tail = HUGE_PAGE_SIZE - (aligned - addr);
+        if (tail) munmap(reinterpret_cast<void*>(aligned + size), tail);
+#  ifdef MADV_HUGEPAGE
+        madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#  endif
+        return reinterpret_cast<void*>(aligned);
+    }
+#endif
+};
+
+template<typename T, typename U>
+inline bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&)
+{
+    return true;
+}
+
+template<typename T, typename U>
+inline bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&)
+{
+    return false;
+}
+_CLS_END
+
+#endif // CLS_ALLOCATOR_HPP
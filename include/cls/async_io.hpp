@@ -0,0 +1,519 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_ASYNC_IO_HPP
+#define CLS_ASYNC_IO_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "file_sys.hpp"
+#include "byte_array.hpp"
+#include "thread_pool.hpp"
+
+// io_uring is used through its system calls directly, only the kernel header is needed
+#if defined __linux__ && defined __has_include
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#    include <sys/syscall.h>
+#    define CLS_HAS_IO_URING 1
+#  endif
+#endif
+#ifndef CLS_HAS_IO_URING
+#  define CLS_HAS_IO_URING 0
+#endif
+
+_CLS_BEGIN
+// A whole file, or length bytes from offset (to the end by default) of a file given by
+// path or by an open descriptor. Reads past the end return the bytes up to it.
+struct ReadRequest {
+    string   path;
+    int      fd     = -1;
+    uint64_t offset = 0;
+    size_t   length = size_t(-1);
+
+    ReadRequest() = default;
+    ReadRequest(const string& file_name) : path(file_name) {}
+    ReadRequest(const string& file_name, uint64_t first, size_t count)
+        : path(file_name), offset(first), length(count) {}
+    ReadRequest(int file, uint64_t first, size_t count)
+        : fd(file), offset(first), length(count) {}
+};
+
+namespace detail {
+inline size_t readLength(uint64_t file_size, uint64_t offset, size_t length)
+{
+    return offset >= file_size ? 0 : static_cast<size_t>(min<uint64_t>(length, file_size - offset));
+}
+
+// Blocking read of one request, returns 0 or an errno value
+inline int readRequest(const ReadRequest& request, ByteArray& data)
+{
+    data.clear();
+#ifdef _WIN32
+    if (request.fd >= 0) return EBADF;
+    ifstream ifs(request.path, ios::binary | ios::ate);
+    if (!ifs) return ENOENT;
+    auto size = readLength(static_cast<uint64_t>(ifs.tellg()), request.offset, request.length);
+    ifs.seekg(static_cast<streamoff>(request.offset));
+    data.resize_uninitialized(size);
+    ifs.read(data.data(), size);
+    data.resize(static_cast<size_t>(ifs.gcount()));
+    return ifs.bad() ? EIO : 0;
+#else
+    int fd = request.fd;
+    if (fd < 0) fd = ::open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno;
+
+    int error = 0;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        error = errno;
+    } else {
+        auto size = readLength(static_cast<uint64_t>(info.st_size), request.offset, request.length);
+        data.resize_uninitialized(size);
+        size_t done = 0;
+        while (done < size) {
+            auto bytes = pread(fd, data.data() + done, size - done,
+                               static_cast<off_t>(request.offset + done));
+            if (bytes < 0 && errno == EINTR) continue;
+            if (bytes < 0) error = errno;
+            if (bytes <= 0) break;
+            done += static_cast<size_t>(bytes);
+        }
+        data.resize(done);
+    }
+    if (request.fd < 0) ::close(fd);
+    return error;
+#endif
+}
+
+#if CLS_HAS_IO_URING
+// Minimal io_uring wrapper: submission and completion rings mapped from the kernel, one
+// producer (this thread) and one consumer on each side
+class IoUring {
+public:
+    explicit IoUring(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd < 0) return;
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sq_size = cq_size = max(sq_size, cq_size);
+        sq_ptr = mapRing(sq_size, IORING_OFF_SQ_RING);
+        cq_ptr = single ? sq_ptr : mapRing(cq_size, IORING_OFF_CQ_RING);
+        sqe_size = params.sq_entries * sizeof(io_uring_sqe);
+        auto sqe_ptr = mapRing(sqe_size, IORING_OFF_SQES);
+        if (!sq_ptr || !cq_ptr || !sqe_ptr || !supportsOps()) {
+            if (sqe_ptr) munmap(sqe_ptr, sqe_size);
+            release();
+            return;
+        }
+
+        auto sq = static_cast<char*>(sq_ptr);
+        auto cq = static_cast<char*>(cq_ptr);
+        sq_head  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_local = *sq_tail;
+        sq_mask  = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqes     = static_cast<io_uring_sqe*>(sqe_ptr);
+        cq_head  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask  = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes) munmap(sqes, sqe_size);
+        release();
+    }
+
+    bool valid() const { return sqes != nullptr; }
+
+    // The caller keeps the number of unfinished operations within the ring size
+    io_uring_sqe* nextSqe() {
+        auto idx = sq_local++ & sq_mask;
+        sq_array[idx] = idx;
+        auto sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Publish the new entries and wait for at least one completion, false on error
+    bool submitAndWait() {
+        __atomic_store_n(sq_tail, sq_local, __ATOMIC_RELEASE);
+        while (true) {
+            auto to_submit = sq_local - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+            auto ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS,
+                               nullptr, 0);
+            if (ret >= 0 || errno == EBUSY) return true;    // EBUSY: reap completions first
+            if (errno != EINTR && errno != EAGAIN) return false;
+        }
+    }
+
+    // Take back the entries not yet consumed by the kernel, returns how many
+    unsigned cancelUnsubmitted() {
+        auto head    = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        auto dropped = sq_local - head;
+        sq_local = head;
+        __atomic_store_n(sq_tail, sq_local, __ATOMIC_RELEASE);
+        return dropped;
+    }
+
+    // Call func(user_data, result) for every completion so far
+    template<typename Func>
+    void reap(Func func) {
+        auto head = *cq_head;
+        auto tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            auto cqe = cqes[head & cq_mask];
+            __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+            func(cqe.user_data, cqe.res);
+        }
+    }
+
+private:
+    void* mapRing(size_t size, off_t offset) {
+        auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring_fd, offset);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    // openat and read need Linux 5.6
+    bool supportsOps() {
+        const unsigned num_ops = 256;
+        vector<char> buffer(sizeof(io_uring_probe) + num_ops * sizeof(io_uring_probe_op), 0);
+        if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, buffer.data(), num_ops) < 0) {
+            return false;
+        }
+        auto probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        auto ops   = reinterpret_cast<io_uring_probe_op*>(buffer.data() + sizeof(io_uring_probe));
+        auto has_op = [&](unsigned op) {
+            return op <= probe->last_op && op < probe->ops_len &&
+                   (ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+        };
+        return has_op(IORING_OP_OPENAT) && has_op(IORING_OP_READ);
+    }
+
+    void release() {
+        if (cq_ptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+        if (sq_ptr) munmap(sq_ptr, sq_size);
+        if (ring_fd >= 0) ::close(ring_fd);
+        sq_ptr = cq_ptr = nullptr;
+        ring_fd = -1;
+    }
+
+    int ring_fd = -1;
+    void* sq_ptr = nullptr;
+    void* cq_ptr = nullptr;
+    size_t sq_size = 0, cq_size = 0, sqe_size = 0;
+    unsigned* sq_head  = nullptr;
+    unsigned* sq_tail  = nullptr;
+    unsigned  sq_local = 0;
+    unsigned* sq_array = nullptr;
+    unsigned  sq_mask  = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* cq_head  = nullptr;
+    unsigned* cq_tail  = nullptr;
+    unsigned  cq_mask  = 0;
+    io_uring_cqe* cqes = nullptr;
+};
+#endif
+} // End namespace detail
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Read a batch of files or file ranges with up to queue_depth requests in flight. On
+// Linux 5.6+ the opens and reads are queued in io_uring, so one thread keeps the device
+// busy; otherwise each request is a blocking open/pread task on the thread pool.
+//
+// Completions are delivered on the calling thread as func(index, ByteArray&& data, error)
+// with the index into the batch and 0 or an errno value, in completion order. A reader
+// is used by one thread at a time. The pool fallback must not be used from a task
+// running on the same pool.
+class AsyncFileReader {
+public:
+    explicit AsyncFileReader(size_t queue_depth = 64, ThreadPool* pool = nullptr,
+                             bool use_uring = true)
+        : depth(max<size_t>(queue_depth, 1)), pool(pool ? pool : &ThreadPool::instance()) {
+#if CLS_HAS_IO_URING
+        if (use_uring) {
+            ring.reset(new detail::IoUring(static_cast<unsigned>(min<size_t>(depth, 4096))));
+            if (!ring->valid()) ring.reset();
+            else depth = min<size_t>(depth, 4096);
+        }
+#else
+        (void)use_uring;
+#endif
+    }
+
+    // True if the reads go through io_uring
+    bool usesUring() const {
+#if CLS_HAS_IO_URING
+        return ring != nullptr;
+#else
+        return false;
+#endif
+    }
+
+    size_t queueDepth() const { return depth; }
+
+    template<typename Func>
+    void read(const vector<ReadRequest>& requests, Func func) {
+#if CLS_HAS_IO_URING
+        if (ring) return readUring(requests, func);
+#endif
+        readPool(requests, func);
+    }
+
+    // Contents of all requests in batch order, throws FileExcept if one fails
+    vector<ByteArray> read(const vector<ReadRequest>& requests) {
+        vector<ByteArray> results(requests.size());
+        size_t failed = size_t(-1);
+        int failed_error = 0;
+        read(requests, [&](size_t idx, ByteArray&& data, int error) {
+            if (error && failed == size_t(-1)) {
+                failed       = idx;
+                failed_error = error;
+            }
+            results[idx] = move(data);
+        });
+        if (failed != size_t(-1)) {
+            string err_msg = "Could not read file " + requests[failed].path + ": " +
+                             strerror(failed_error);
+#if CLS_HAS_EXCEPT
+            throw FileExcept(err_msg);
+#else
+            cerr << err_msg << endl;
+#endif
+        }
+        return results;
+    }
+
+private:
+    template<typename Func>
+    void readPool(const vector<ReadRequest>& requests, Func& func) {
+        using Result = pair<ByteArray, int>;
+        deque<pair<size_t, future<Result>>> in_flight;
+        auto finish_front = [&] {
+            auto result = in_flight.front().second.get();
+            auto idx    = in_flight.front().first;
+            in_flight.pop_front();
+            func(idx, move(result.first), result.second);
+        };
+        auto pump = [&] {
+            for (size_t idx = 0; idx < requests.size(); ++idx) {
+                if (in_flight.size() == depth) finish_front();
+                auto request = &requests[idx];
+                in_flight.emplace_back(idx, pool->submit([request] {
+                    Result result;
+                    result.second = detail::readRequest(*request, result.first);
+                    return result;
+                }));
+            }
+            while (!in_flight.empty()) finish_front();
+        };
+#if CLS_HAS_EXCEPT
+        try {
+            pump();
+        } catch (...) {     // From func, the queued tasks still read the requests
+            for (auto& task : in_flight) task.second.wait();
+            throw;
+        }
+#else
+        pump();
+#endif
+    }
+
+#if CLS_HAS_IO_URING
+    struct Slot {
+        size_t   index;
+        int      fd;
+        bool     opening;
+        uint64_t offset;
+        size_t   done;
+        ByteArray data;
+    };
+
+    template<typename Func>
+    void readUring(const vector<ReadRequest>& requests, Func& func) {
+        vector<Slot> slots(depth);
+        vector<bool> queued(depth, false);     // Slot has an operation in the ring
+        vector<size_t> free_slots;
+        for (size_t i = depth; i-- > 0;) free_slots.push_back(i);
+
+        auto complete = [&](size_t slot_id, int error) {
+            auto& slot = slots[slot_id];
+            if (slot.fd >= 0 && requests[slot.index].fd < 0) ::close(slot.fd);
+            if (error) slot.data.clear();
+            else       slot.data.resize(slot.done);
+            free_slots.push_back(slot_id);
+            func(slot.index, move(slot.data), error);
+        };
+        auto queue_read = [&](size_t slot_id) {
+            auto& slot = slots[slot_id];
+            auto sqe   = ring->nextSqe();
+            sqe->opcode    = IORING_OP_READ;
+            sqe->fd        = slot.fd;
+            sqe->off       = slot.offset + slot.done;
+            sqe->addr      = reinterpret_cast<uint64_t>(slot.data.data() + slot.done);
+            sqe->len       = static_cast<uint32_t>(min<size_t>(slot.data.size() - slot.done, size_t(1) << 30));
+            sqe->user_data = slot_id;
+            queued[slot_id] = true;
+        };
+        auto queue_open = [&](size_t slot_id) {
+            auto sqe = ring->nextSqe();
+            sqe->opcode     = IORING_OP_OPENAT;
+            sqe->fd         = AT_FDCWD;
+            sqe->addr       = reinterpret_cast<uint64_t>(requests[slots[slot_id].index].path.c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data  = slot_id;
+            queued[slot_id] = true;
+        };
+        // Size the buffer from the file and read, or finish an empty range right away
+        auto start_read = [&](size_t slot_id) {
+            auto& slot = slots[slot_id];
+            auto& request = requests[slot.index];
+            struct stat info;
+            if (fstat(slot.fd, &info) != 0) return complete(slot_id, errno);
+            slot.opening = false;
+            slot.done    = 0;
+            slot.data.resize_uninitialized(
+                detail::readLength(static_cast<uint64_t>(info.st_size), request.offset, request.length));
+            if (slot.data.empty()) return complete(slot_id, 0);
+            queue_read(slot_id);
+        };
+
+        // Fill the free slots, submit and handle completions until the batch is done, false
+        // if io_uring_enter failed
+        size_t next = 0;
+        auto pump = [&] {
+            while (next < requests.size() || free_slots.size() < depth) {
+                while (next < requests.size() && !free_slots.empty()) {
+                    auto slot_id = free_slots.back();
+                    free_slots.pop_back();
+                    auto& slot    = slots[slot_id];
+                    auto& request = requests[next];
+                    slot.index  = next++;
+                    slot.fd     = request.fd;
+                    slot.offset = request.offset;
+                    slot.data.clear();
+                    if (slot.fd >= 0) {
+                        start_read(slot_id);
+                        continue;
+                    }
+                    slot.opening = true;
+                    queue_open(slot_id);
+                }
+                if (free_slots.size() == depth) continue;   // Everything finished synchronously
+
+                if (!ring->submitAndWait()) return false;
+                ring->reap([&](uint64_t slot_id, int res) {
+                    auto& slot = slots[slot_id];
+                    queued[slot_id] = false;
+                    if (res == -EINTR || res == -EAGAIN) {
+                        if (slot.opening) queue_open(slot_id);
+                        else              queue_read(slot_id);
+                    } else if (res < 0) {
+                        if (slot.opening) slot.fd = -1;
+                        complete(slot_id, -res);
+                    } else if (slot.opening) {
+                        slot.fd = res;
+                        start_read(slot_id);
+                    } else {
+                        slot.done += static_cast<size_t>(res);
+                        if (res == 0 || slot.done == slot.data.size()) complete(slot_id, 0);
+                        else queue_read(slot_id);
+                    }
+                });
+            }
+            return true;
+        };
+
+        // Wait for every submitted operation before the slot buffers go away, entries the
+        // kernel hasn't taken are dropped. Then close the files of the unfinished slots.
+        auto drain = [&] {
+            size_t in_flight = count(queued.begin(), queued.end(), true) - ring->cancelUnsubmitted();
+            while (in_flight) {
+                if (!ring->submitAndWait()) this_thread::sleep_for(chrono::microseconds(100));
+                ring->reap([&](uint64_t slot_id, int res) {
+                    if (slots[slot_id].opening && res >= 0) ::close(res);
+                    --in_flight;
+                });
+            }
+            vector<bool> idle(depth, false);
+            for (auto slot_id : free_slots) idle[slot_id] = true;
+            for (size_t slot_id = 0; slot_id < depth; ++slot_id) {
+                auto& slot = slots[slot_id];
+                if (!idle[slot_id] && slot.fd >= 0 && requests[slot.index].fd < 0) ::close(slot.fd);
+            }
+        };
+
+        bool submitted = true;
+#if CLS_HAS_EXCEPT
+        try {
+            submitted = pump();
+        } catch (...) {     // From func, the buffers are still targets of queued reads
+            drain();
+            throw;
+        }
+#else
+        submitted = pump();
+#endif
+        if (!submitted) {
+            // Later batches use the pool
+            auto err_msg = string("io_uring_enter failed: ") + strerror(errno);
+            drain();
+            ring.reset();
+#if CLS_HAS_EXCEPT
+            throw FileExcept(err_msg);
+#else
+            cerr << err_msg << endl;
+#endif
+        }
+    }
+
+    unique_ptr<detail::IoUring> ring;
+#endif
+
+    size_t depth;
+    ThreadPool* pool;
+};
+_CLS_END
+
+#endif // CLS_ASYNC_IO_HPP
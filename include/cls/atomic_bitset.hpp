@@ -0,0 +1,185 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_ATOMIC_BITSET_HPP
+#define CLS_ATOMIC_BITSET_HPP
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <future>
+#include <algorithm>
+#include "allocator.hpp"
+#include "bit_ops.hpp"
+#include "dyn_bitset.hpp"
+#include "thread_pool.hpp"
+
+_CLS_BEGIN
+// Fixed size bitset whose single bit operations are atomic read-modify-writes of the
+// containing 64-bit word, so any number of threads may set, reset and test bits at the
+// same time without a lock. Bit idx is bit idx % 64 of word idx / 64. Bulk reads (count,
+// for_each_set, toDynBitset) load each word atomically with relaxed order: they see
+// every update that happened before them, concurrent ones may or may not be included.
+class AtomicBitset {
+    using Word = uint64_t;
+    static const size_t WORDSIZE = 64;
+
+public:
+    explicit AtomicBitset(size_t n = 0)
+        : bit_field((n + WORDSIZE - 1) / WORDSIZE), bit_size(n) {}
+
+    explicit AtomicBitset(const DynBitset& bits) : AtomicBitset(bits.size()) {
+        bits.for_each_set([this](size_t idx) {
+            bit_field[idx / WORDSIZE].fetch_or(maskOf(idx), memory_order_relaxed);
+        });
+    }
+
+    AtomicBitset(const AtomicBitset&) = delete;
+    AtomicBitset& operator=(const AtomicBitset&) = delete;
+
+    size_t size() const      { return bit_size; }
+    size_t num_words() const { return bit_field.size(); }
+
+    bool test(size_t idx, memory_order order = memory_order_seq_cst) const {
+        return (bit_field[idx / WORDSIZE].load(order) & maskOf(idx)) != 0;
+    }
+
+    bool operator[](size_t idx) const { return test(idx); }
+
+    void set(size_t idx, memory_order order = memory_order_seq_cst) {
+        test_and_set(idx, order);
+    }
+
+    void reset(size_t idx, memory_order order = memory_order_seq_cst) {
+        test_and_reset(idx, order);
+    }
+
+    // Set the bit and return its old value. A load first skips the write when the bit is
+    // set already, which keeps the cache line shared on repeated visits. That load has
+    // the acquire part of order, there is nothing to release without a write.
+    bool test_and_set(size_t idx, memory_order order = memory_order_seq_cst) {
+        auto& word = bit_field[idx / WORDSIZE];
+        auto  mask = maskOf(idx);
+        if (word.load(loadOrder(order)) & mask) return true;
+        return (word.fetch_or(mask, order) & mask) != 0;
+    }
+
+    bool test_and_reset(size_t idx, memory_order order = memory_order_seq_cst) {
+        auto& word = bit_field[idx / WORDSIZE];
+        auto  mask = maskOf(idx);
+        if (!(word.load(loadOrder(order)) & mask)) return false;
+        return (word.fetch_and(~mask, order) & mask) != 0;
+    }
+
+    // Flip the bit and return its old value
+    bool flip(size_t idx, memory_order order = memory_order_seq_cst) {
+        auto mask = maskOf(idx);
+        return (bit_field[idx / WORDSIZE].fetch_xor(mask, order) & mask) != 0;
+    }
+
+    // Whole word access, bit j of word k is index 64 * k + j
+    Word word(size_t k, memory_order order = memory_order_relaxed) const {
+        return bit_field[k].load(order);
+    }
+
+    // Atomically or/and a whole word, return the old word
+    Word fetch_or(size_t k, Word bits, memory_order order = memory_order_seq_cst) {
+        return bit_field[k].fetch_or(bits, order);
+    }
+
+    Word fetch_and(size_t k, Word bits, memory_order order = memory_order_seq_cst) {
+        return bit_field[k].fetch_and(bits, order);
+    }
+
+    // Clear every bit, not atomic as a whole
+    void clear() {
+        for (auto& word : bit_field) word.store(0, memory_order_relaxed);
+    }
+
+    size_t count() const {
+        return countWords(0, bit_field.size());
+    }
+
+    // Count with one chunk per worker, for very large sets
+    size_t count(ThreadPool& pool) const {
+        auto num_words = bit_field.size();
+        auto chunks    = min(pool.size(), max<size_t>(num_words / 4096, 1));
+        auto chunk     = (num_words + chunks - 1) / chunks;
+        vector<future<size_t>> results;
+        for (size_t first = 0; first < num_words; first += chunk) {
+            auto last = min(first + chunk, num_words);
+            results.push_back(pool.submit([this, first, last] { return countWords(first, last); }));
+        }
+        size_t total = 0;
+        for (auto& result : results) total += result.get();
+        return total;
+    }
+
+    bool any() const {
+        return any_of(bit_field.begin(), bit_field.end(), [](const atomic<Word>& word) {
+            return word.load(memory_order_relaxed) != 0;
+        });
+    }
+
+    bool none() const { return !any(); }
+
+    // Calls func(idx) for each set index in ascending order
+    template<typename Func>
+    void for_each_set(Func func) const {
+        for (size_t k = 0; k < bit_field.size(); ++k) {
+            for (auto bits = word(k); bits; bits &= bits - 1) {
+                func(k * WORDSIZE + ctz(bits));
+            }
+        }
+    }
+
+    DynBitset toDynBitset() const {
+        DynBitset result(bit_size);
+        for_each_set([&result](size_t idx) { result[idx] = true; });
+        return result;
+    }
+
+private:
+    static Word maskOf(size_t idx) {
+        return Word(1) << (idx % WORDSIZE);
+    }
+
+    // Strongest order a load accepts out of a read-modify-write order
+    static memory_order loadOrder(memory_order order) {
+        return order == memory_order_release ? memory_order_relaxed :
+               order == memory_order_acq_rel ? memory_order_acquire : order;
+    }
+
+    size_t countWords(size_t first, size_t last) const {
+        size_t total = 0;
+        for (auto k = first; k < last; ++k) total += popcount(word(k));
+        return total;
+    }
+
+    vector<atomic<Word>, AlignedAllocator<atomic<Word>, 64>> bit_field;
+    size_t bit_size;
+};
+_CLS_END
+
+#endif // CLS_ATOMIC_BITSET_HPP
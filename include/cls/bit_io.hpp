@@ -0,0 +1,250 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_BIT_IO_HPP
+#define CLS_BIT_IO_HPP
+
+#include <cstdint>
+#include "byte_array.hpp"
+#include "endian.hpp"
+#include "bit_ops.hpp"
+#include "dyn_bitset.hpp"
+
+_CLS_BEGIN
+//////////////////////////////////////////////////////////////////////////////////////////
+// Write a bit stream most significant bit first, the same order as BitField and the
+// bytes of DynBitset::toByteArray(). Bits collect in a 64-bit register that is stored
+// as 8 big endian bytes when full; flush() or the destructor pads the last byte with
+// zeros. BitField(writer.size(), buffer) turns the result into a bitset.
+class BitWriter {
+public:
+    explicit BitWriter(ByteArray& buffer)
+        : buf(buffer), acc(0), acc_bits(0), written(0) {}
+
+    BitWriter(const BitWriter&) = delete;
+    BitWriter& operator=(const BitWriter&) = delete;
+
+    ~BitWriter() { flush(); }
+
+    // Low n bits of value, n <= 64
+    BitWriter& write_bits(uint64_t value, int n) {
+        if (n == 0) return *this;
+        if (n < 64) value &= (uint64_t(1) << n) - 1;
+        written += n;
+        auto free_bits = 64 - acc_bits;
+        if (n < free_bits) {
+            acc |= value << (free_bits - n);
+            acc_bits += n;
+            return *this;
+        }
+        acc |= value >> (n - free_bits);
+        storeBE(buf.reserve_for_write(8), acc);
+        auto rest = n - free_bits;
+        acc      = rest ? value << (64 - rest) : 0;
+        acc_bits = rest;
+        return *this;
+    }
+
+    BitWriter& write_bit(bool bit) { return write_bits(bit, 1); }
+
+    // Unsigned Exp-Golomb code, value < 2^64 - 1
+    BitWriter& write_ue(uint64_t value) {
+        ASSERT(value != ~uint64_t(0));
+        auto len = 64 - clz(value + 1);
+        write_bits(0, len - 1);
+        return write_bits(value + 1, len);
+    }
+
+    // Signed Exp-Golomb code, 1, -1, 2, -2... map to 1, 2, 3, 4...
+    BitWriter& write_se(int64_t value) {
+        auto mapped = value > 0 ? 2 * uint64_t(value) - 1 : 2 * (0 - uint64_t(value));
+        return write_ue(mapped);
+    }
+
+    // Pad with zeros up to the next byte boundary
+    BitWriter& align() {
+        return write_bits(0, (8 - written % 8) % 8);
+    }
+
+    // Number of bits written
+    uint64_t size() const { return written; }
+
+    // Store the pending bits, padding to a whole byte
+    void flush() {
+        align();
+        auto bytes = acc_bits / 8;
+        auto ptr   = buf.reserve_for_write(bytes);
+        for (int i = 0; i < bytes; ++i) ptr[i] = static_cast<char>(acc >> (56 - 8 * i));
+        acc      = 0;
+        acc_bits = 0;
+    }
+
+private:
+    ByteArray& buf;
+    uint64_t   acc;
+    int        acc_bits;
+    uint64_t   written;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Read a bit stream most significant bit first from bytes, or from a DynBitset/BitField
+// in string order. Up to 64 bits are buffered in a register that is refilled with one
+// 64-bit load, so reads of any width are a shift and a mask most of the time. Like
+// ByteReader a read past the end sets a sticky error and yields 0.
+class BitReader {
+public:
+    enum class Error { None, OutOfRange, BadCode };
+
+    explicit BitReader(ByteView data)
+        : bytes(data.data()), words(nullptr), total(uint64_t(data.size()) * 8), next(0),
+          cache(0), cache_bits(0), err(Error::None) {}
+
+    // The bitset must outlive the reader
+    explicit BitReader(const DynBitset& bits)
+        : bytes(nullptr), words(bits.data()), total(bits.size()), next(0),
+          cache(0), cache_bits(0), err(Error::None) {}
+
+    BitReader(DynBitset&&) = delete;
+
+    // n <= 64 bits as an unsigned value
+    uint64_t read_bits(int n) {
+        auto result = peek_bits(n);
+        if (ok()) consume(n);
+        return result;
+    }
+
+    // Next n <= 64 bits without consuming them
+    uint64_t peek_bits(int n) {
+        if (n > cache_bits) {
+            refill();
+            if (n > cache_bits) return fail(Error::OutOfRange), 0;
+        }
+        return n ? cache >> (64 - n) : 0;
+    }
+
+    bool read_bit() { return read_bits(1) != 0; }
+
+    bool skip_bits(uint64_t n) {
+        if (n > remaining()) return fail(Error::OutOfRange);
+        if (n <= uint64_t(cache_bits)) {
+            consume(static_cast<int>(n));
+        } else {
+            next += n - cache_bits;
+            cache      = 0;
+            cache_bits = 0;
+        }
+        return true;
+    }
+
+    // Unsigned Exp-Golomb code
+    uint64_t read_ue() {
+        if (cache_bits < 64) refill();
+        if (cache == 0) {
+            // More than 63 leading zeros, or the end of data
+            return fail(remaining() >= 64 ? Error::BadCode : Error::OutOfRange), 0;
+        }
+        auto zeros = clz(cache);
+        consume(zeros);
+        auto value = read_bits(zeros + 1);
+        return ok() ? value - 1 : 0;
+    }
+
+    int64_t read_se() {
+        auto mapped = read_ue();
+        return mapped & 1 ? int64_t((mapped >> 1) + 1) : -int64_t(mapped >> 1);
+    }
+
+    // Skip to the next byte boundary
+    bool align() {
+        return skip_bits((8 - position() % 8) % 8);
+    }
+
+    uint64_t position() const  { return next - cache_bits; }
+    uint64_t remaining() const { return total - position(); }
+    bool     atEnd() const     { return remaining() == 0; }
+
+    bool  ok() const    { return err == Error::None; }
+    Error error() const { return err; }
+    void  clearError()  { err = Error::None; }
+
+private:
+    void consume(int n) {
+        cache = n < 64 ? cache << n : 0;
+        cache_bits -= n;
+    }
+
+    // Top up the register to 64 bits or to the end of data
+    void refill() {
+        auto take = min<uint64_t>(64 - cache_bits, total - next);
+        if (take == 0) return;
+        cache |= load64(next) >> cache_bits;
+        if (take < uint64_t(64 - cache_bits)) {
+            // Drop what lies past the end in the last byte or word
+            auto keep = cache_bits + static_cast<int>(take);
+            cache &= ~(~uint64_t(0) >> keep);
+        }
+        cache_bits += static_cast<int>(take);
+        next       += take;
+    }
+
+    // 64 bits starting at bit pos, zero padded past the end of the storage
+    uint64_t load64(uint64_t pos) const {
+        auto shift = static_cast<int>(pos % (words ? 64 : 8));
+        if (words) {
+            auto idx  = static_cast<size_t>(pos / 64);
+            auto last = static_cast<size_t>((total + 63) / 64);
+            auto high = words[idx] << shift;
+            return shift && idx + 1 < last ? high | words[idx + 1] >> (64 - shift) : high;
+        }
+        auto idx  = static_cast<size_t>(pos / 8);
+        auto size = static_cast<size_t>(total / 8);
+        if (idx + 9 <= size) {
+            auto high = loadBE<uint64_t>(bytes + idx) << shift;
+            return shift ? high | uint64_t(uchar(bytes[idx + 8])) >> (8 - shift) : high;
+        }
+        uint64_t result = 0;
+        for (int i = 0; i < 9 && idx + i < size; ++i) {
+            auto byte = uint64_t(uchar(bytes[idx + i]));
+            auto at   = 56 - 8 * i + shift;
+            result |= at >= 0 ? byte << at : byte >> -at;
+        }
+        return result;
+    }
+
+    bool fail(Error error) {
+        if (err == Error::None) err = error;
+        return false;
+    }
+
+    const char*     bytes;
+    const uint64_t* words;
+    uint64_t total;
+    uint64_t next;          // Next bit to load into the register
+    uint64_t cache;         // Buffered bits, most significant first
+    int      cache_bits;
+    Error    err;
+};
+_CLS_END
+
+#endif // CLS_BIT_IO_HPP
@@ -0,0 +1,265 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_BIT_OPS_HPP
+#define CLS_BIT_OPS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include "cls_defs.h"
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+#if CLS_HAS_AVX2 || CLS_HAS_BMI2
+#  include <immintrin.h>
+#endif
+
+_CLS_BEGIN
+// Word level bit helpers. With -mpopcnt/-mbmi (or -march=native) they compile to
+// popcnt, tzcnt and lzcnt, otherwise to the compiler's portable fallback.
+
+inline int popcount(uint64_t word)
+{
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(word));
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+// Number of trailing zero bits, word must not be 0
+inline int ctz(uint64_t word)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, word);
+    return static_cast<int>(idx);
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+// Number of leading zero bits, word must not be 0
+inline int clz(uint64_t word)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, word);
+    return 63 - static_cast<int>(idx);
+#else
+    return __builtin_clzll(word);
+#endif
+}
+
+// Index of the r-th (from 0) lowest set bit, word must have more than r bits set
+inline int selectBit(uint64_t word, int r)
+{
+#if CLS_HAS_BMI2
+    return ctz(_pdep_u64(uint64_t(1) << r, word));
+#else
+    int base = 0;
+    for (;; base += 8, word >>= 8) {
+        int byte_count = popcount(word & 0xFF);
+        if (r < byte_count) break;
+        r -= byte_count;
+    }
+    for (; r > 0; --r) word &= word - 1;
+    return base + ctz(word);
+#endif
+}
+
+// Hint the cache to load the line holding ptr
+inline void prefetch(const void* ptr)
+{
+#ifdef _MSC_VER
+    _mm_prefetch(static_cast<const char*>(ptr), _MM_HINT_T0);
+#else
+    __builtin_prefetch(ptr);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Kernels over word arrays, vectorized with AVX2 when it is enabled
+namespace detail {
+struct OpAnd {
+    uint64_t operator()(uint64_t a, uint64_t b) const { return a & b; }
+#if CLS_HAS_AVX2
+    __m256i operator()(__m256i a, __m256i b) const { return _mm256_and_si256(a, b); }
+#endif
+};
+
+struct OpOr {
+    uint64_t operator()(uint64_t a, uint64_t b) const { return a | b; }
+#if CLS_HAS_AVX2
+    __m256i operator()(__m256i a, __m256i b) const { return _mm256_or_si256(a, b); }
+#endif
+};
+
+struct OpXor {
+    uint64_t operator()(uint64_t a, uint64_t b) const { return a ^ b; }
+#if CLS_HAS_AVX2
+    __m256i operator()(__m256i a, __m256i b) const { return _mm256_xor_si256(a, b); }
+#endif
+};
+
+// a & ~b
+struct OpAndNot {
+    uint64_t operator()(uint64_t a, uint64_t b) const { return a & ~b; }
+#if CLS_HAS_AVX2
+    __m256i operator()(__m256i a, __m256i b) const { return _mm256_andnot_si256(b, a); }
+#endif
+};
+
+// Only the left operand counts
+struct OpFirst {
+    uint64_t operator()(uint64_t a, uint64_t) const { return a; }
+#if CLS_HAS_AVX2
+    __m256i operator()(__m256i a, __m256i) const { return a; }
+#endif
+};
+
+#if CLS_HAS_AVX2
+inline __m256i loadWords(const uint64_t* ptr)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+}
+
+// Per 64-bit lane popcount with a nibble lookup table (W. Mula)
+inline __m256i popcount256(__m256i val)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    auto lo  = _mm256_and_si256(val, low_mask);
+    auto hi  = _mm256_and_si256(_mm256_srli_epi16(val, 4), low_mask);
+    auto cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+inline size_t horizontalSum(__m256i val)
+{
+    return static_cast<size_t>(_mm256_extract_epi64(val, 0)) +
+           static_cast<size_t>(_mm256_extract_epi64(val, 1)) +
+           static_cast<size_t>(_mm256_extract_epi64(val, 2)) +
+           static_cast<size_t>(_mm256_extract_epi64(val, 3));
+}
+#endif
+
+// dst[i] = op(dst[i], src[i])
+template<typename Op>
+inline void applyWords(uint64_t* dst, const uint64_t* src, size_t n, Op op)
+{
+    size_t idx = 0;
+#if CLS_HAS_AVX2
+    for (auto vec_end = n & ~size_t(7); idx < vec_end; idx += 8) {
+        auto v0 = op(loadWords(dst + idx),     loadWords(src + idx));
+        auto v1 = op(loadWords(dst + idx + 4), loadWords(src + idx + 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + idx), v0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + idx + 4), v1);
+    }
+#endif
+    for (; idx < n; ++idx) {
+        dst[idx] = op(dst[idx], src[idx]);
+    }
+}
+
+// Number of set bits in op(a[i], b[i]) without materializing the result
+template<typename Op>
+inline size_t popcountWords(const uint64_t* a, const uint64_t* b, size_t n, Op op)
+{
+    size_t total = 0;
+    size_t idx   = 0;
+#if CLS_HAS_AVX2
+    // The SAD result of a lane is at most 64, so the accumulators can't overflow
+    auto acc0 = _mm256_setzero_si256();
+    auto acc1 = _mm256_setzero_si256();
+    for (auto vec_end = n & ~size_t(7); idx < vec_end; idx += 8) {
+        acc0 = _mm256_add_epi64(acc0, popcount256(op(loadWords(a + idx),     loadWords(b + idx))));
+        acc1 = _mm256_add_epi64(acc1, popcount256(op(loadWords(a + idx + 4), loadWords(b + idx + 4))));
+    }
+    total = horizontalSum(_mm256_add_epi64(acc0, acc1));
+#endif
+    size_t c0 = 0, c1 = 0;
+    for (; idx + 2 <= n; idx += 2) {
+        c0 += popcount(op(a[idx],     b[idx]));
+        c1 += popcount(op(a[idx + 1], b[idx + 1]));
+    }
+    for (; idx < n; ++idx) {
+        c0 += popcount(op(a[idx], b[idx]));
+    }
+    return total + c0 + c1;
+}
+} // End namespace detail
+
+// Number of set bits in n words
+inline size_t popcount(const uint64_t* words, size_t n)
+{
+    return detail::popcountWords(words, words, n, detail::OpFirst());
+}
+
+inline void andWords(uint64_t* dst, const uint64_t* src, size_t n)
+{
+    detail::applyWords(dst, src, n, detail::OpAnd());
+}
+
+inline void orWords(uint64_t* dst, const uint64_t* src, size_t n)
+{
+    detail::applyWords(dst, src, n, detail::OpOr());
+}
+
+inline void xorWords(uint64_t* dst, const uint64_t* src, size_t n)
+{
+    detail::applyWords(dst, src, n, detail::OpXor());
+}
+
+// dst &= ~src
+inline void andNotWords(uint64_t* dst, const uint64_t* src, size_t n)
+{
+    detail::applyWords(dst, src, n, detail::OpAndNot());
+}
+
+inline size_t popcountAnd(const uint64_t* a, const uint64_t* b, size_t n)
+{
+    return detail::popcountWords(a, b, n, detail::OpAnd());
+}
+
+inline size_t popcountOr(const uint64_t* a, const uint64_t* b, size_t n)
+{
+    return detail::popcountWords(a, b, n, detail::OpOr());
+}
+
+inline size_t popcountXor(const uint64_t* a, const uint64_t* b, size_t n)
+{
+    return detail::popcountWords(a, b, n, detail::OpXor());
+}
+
+inline size_t popcountAndNot(const uint64_t* a, const uint64_t* b, size_t n)
+{
+    return detail::popcountWords(a, b, n, detail::OpAndNot());
+}
+_CLS_END
+
+#endif // CLS_BIT_OPS_HPP
@@ -0,0 +1,229 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_BLOOM_HPP
+#define CLS_BLOOM_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "byte_array.hpp"
+#include "byte_io.hpp"
+#include "bit_ops.hpp"
+#include "dyn_bitset.hpp"
+#include "hash.hpp"
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+_CLS_BEGIN
+namespace detail {
+// High 64 bits of a * b, maps a hash to [0, b) without a division
+inline uint64_t mulHigh64(uint64_t a, uint64_t b)
+{
+#ifdef _MSC_VER
+    return __umulh(a, b);
+#else
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#endif
+}
+} // End namespace detail
+
+// Bloom filter over the word storage of a DynBitset. Keys are reduced to a 64-bit hash
+// (hash64() for byte keys) and the probes are derived from it by double hashing.
+// Blocked filters put all probes of a key into one 512-bit block, which is one cache
+// line of the 64-byte aligned storage: a lookup costs one miss at the price of a
+// slightly higher false positive rate for the same bits per key.
+template<bool Blocked>
+class BasicBloomFilter {
+    static const size_t BLOCK_BITS = 512;
+    static const size_t PREFETCH_DISTANCE = 8;
+
+public:
+    BasicBloomFilter() : num_hashes(0) {}
+
+    // Sized for expected_keys keys at bits_per_key bits each, 10 bits give about 1%
+    // false positives (a bit more for the blocked variant)
+    explicit BasicBloomFilter(size_t expected_keys, double bits_per_key = 10.0) {
+        auto wanted = static_cast<size_t>(ceil(max<double>(expected_keys, 1) * bits_per_key));
+        bits = DynBitset((wanted + BLOCK_BITS - 1) / BLOCK_BITS * BLOCK_BITS);
+        auto k = static_cast<int>(round(bits_per_key * 0.693147));
+        num_hashes = min(max(k, 1), 30);
+    }
+
+    void insert(ByteView key)         { insertHash(hash64(key)); }
+    bool mayContain(ByteView key) const { return mayContainHash(hash64(key)); }
+
+    // An empty filter (default constructed or failed to load) holds nothing
+    void insertHash(uint64_t hash) {
+        if (bits.size() == 0) return;
+        auto words = bits.data();
+        forEachProbe(hash, [words](uint64_t pos) {
+            words[pos / 64] |= uint64_t(1) << (pos % 64);
+            return true;
+        });
+    }
+
+    bool mayContainHash(uint64_t hash) const {
+        if (bits.size() == 0) return false;
+        auto words = bits.data();
+        if (Blocked) {
+            // All probes hit the same cache line, testing them all avoids branches
+            uint64_t found = 1;
+            forEachProbe(hash, [words, &found](uint64_t pos) {
+                found &= words[pos / 64] >> (pos % 64);
+                return true;
+            });
+            return found != 0;
+        }
+        // Most negative lookups stop at the first or second cache line
+        return forEachProbe(hash, [words](uint64_t pos) {
+            return ((words[pos / 64] >> (pos % 64)) & 1) != 0;
+        });
+    }
+
+    // Batch versions, the cache lines of later keys are prefetched while earlier keys
+    // are processed
+    void insertHashes(const uint64_t* hashes, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            if (i + PREFETCH_DISTANCE < n) prefetchKey(hashes[i + PREFETCH_DISTANCE]);
+            insertHash(hashes[i]);
+        }
+    }
+
+    // Write the result of each hash to found, return the number of positives
+    size_t mayContainHashes(const uint64_t* hashes, size_t n, bool* found) const {
+        size_t positives = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (i + PREFETCH_DISTANCE < n) prefetchKey(hashes[i + PREFETCH_DISTANCE]);
+            found[i]   = mayContainHash(hashes[i]);
+            positives += found[i];
+        }
+        return positives;
+    }
+
+    template<typename Container>
+    void insertAll(const Container& keys) {
+        vector<uint64_t> hashes;
+        hashes.reserve(keys.size());
+        for (auto& key : keys) hashes.push_back(hash64(ByteView(key)));
+        insertHashes(hashes.data(), hashes.size());
+    }
+
+    size_t num_bits() const       { return bits.size(); }
+    int    hash_count() const     { return num_hashes; }
+    const DynBitset& bitset() const { return bits; }
+
+    // False positive rate estimated from the fraction of set bits
+    double estimatedFalsePositiveRate() const {
+        if (bits.size() == 0) return 1.0;
+        return pow(double(bits.count()) / bits.size(), num_hashes);
+    }
+
+    void clear() { bits.reset(); }
+
+    // Combine with a filter of the same geometry, the result holds the keys of both
+    bool merge(const BasicBloomFilter& other) {
+        if (bits.size() != other.bits.size() || num_hashes != other.num_hashes) return false;
+        bits |= other.bits;
+        return true;
+    }
+
+    ByteArray toByteArray() const {
+        ByteArray result;
+        ByteWriter writer(result, 16 + 8 * bits.num_words());
+        writer.putBytes(magic()).putLE<uint32_t>(num_hashes).putLE<uint64_t>(bits.size());
+        auto words = bits.data();
+        for (size_t k = 0; k < bits.num_words(); ++k) writer.putLE(words[k]);
+        writer.flush();
+        return result;
+    }
+
+    // False and empty on malformed data or a filter of the other kind
+    bool fromByteArray(ByteView data) {
+        *this = BasicBloomFilter();
+        ByteReader reader(data);
+        ByteView tag;
+        uint32_t k = 0;
+        uint64_t size = 0;
+        reader.getBytes(4, tag);
+        reader.getLE(k);
+        reader.getLE(size);
+        if (!reader.ok() || tag != magic() || k < 1 || k > 30 || size % BLOCK_BITS ||
+            size / 8 != reader.remaining()) {
+            return false;
+        }
+        bits = DynBitset(static_cast<size_t>(size));
+        auto words = bits.data();
+        for (size_t w = 0; w < bits.num_words(); ++w) reader.getLE(words[w]);
+        num_hashes = static_cast<int>(k);
+        return true;
+    }
+
+private:
+    static ByteView magic() {
+        return ByteView(Blocked ? "BLM1" : "BLM0", 4);
+    }
+
+    // Calls func(bit position) for the probes of a key until it returns false, return
+    // false if it did. The filter must not be empty.
+    template<typename Func>
+    bool forEachProbe(uint64_t hash, Func func) const {
+        if (Blocked) {
+            auto block = detail::mulHigh64(hash, bits.size() / BLOCK_BITS) * BLOCK_BITS;
+            auto mixed = hash;
+            for (int i = 0; i < num_hashes; ++i) {
+                mixed *= 0x9E3779B97F4A7C15ull;
+                if (!func(block + (mixed >> 55))) return false;
+            }
+        } else {
+            auto delta = detail::rotl64(hash, 32) | 1;
+            for (int i = 0; i < num_hashes; ++i) {
+                if (!func(detail::mulHigh64(hash, bits.size()))) return false;
+                hash += delta;
+            }
+        }
+        return true;
+    }
+
+    void prefetchKey(uint64_t hash) const {
+        if (bits.size() == 0) return;
+        // The block of a blocked filter, the first probe otherwise since most negative
+        // lookups end there
+        auto words = bits.data();
+        if (Blocked) prefetch(words + detail::mulHigh64(hash, bits.size() / BLOCK_BITS) * (BLOCK_BITS / 64));
+        else         prefetch(words + detail::mulHigh64(hash, bits.size()) / 64);
+    }
+
+    DynBitset bits;
+    int num_hashes;
+};
+
+using BloomFilter        = BasicBloomFilter<false>;
+using BlockedBloomFilter = BasicBloomFilter<true>;
+_CLS_END
+
+#endif // CLS_BLOOM_HPP
@@ -27,93 +27,175 @@
 
 #include <cstring>
 #include <vector>
+#include <initializer_list>
+#include <type_traits>
 #include <string>
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include "cls_defs.h"
+#include "allocator.hpp"
 
 _CLS_BEGIN
-class ByteArray : public vector<char> {
+// Byte array with selectable allocator. New bytes are zero filled by the constructors
+// and resize() as usual, resize_uninitialized() and reserve_for_write() leave them
+// uninitialized for buffers that are about to be overwritten anyway.
+template<typename Alloc = allocator<char>>
+class BasicByteArray : public vector<char, DefaultInitAllocator<char, Alloc>> {
 public:
-    using Base = vector<char>;
-
-    ByteArray() = default;
-    ByteArray(const Base& data) : Base(data) {}
-    ByteArray(Base&& data) : Base(move(data)) {}
-#if CPP11_SUPPORT
-    using Base::Base;
-#else
-    ByteArray(size_t n, char byte = char())
+    using Base = vector<char, DefaultInitAllocator<char, Alloc>>;
+
+    BasicByteArray() = default;
+    BasicByteArray(const Base& data) : Base(data) {}
+    BasicByteArray(Base&& data) : Base(move(data)) {}
+
+    // Interop with vector<char>, the type ByteArray used to be. Both directions copy as
+    // the allocator types differ.
+    BasicByteArray(const vector<char>& data)
+        : Base(data.begin(), data.end()) {}
+
+    explicit BasicByteArray(size_t n, char byte = char())
         : Base(n, byte) {}
 
-    template<typename InputIterator>
-    ByteArray(InputIterator first, InputIterator last)
+    template<typename InputIterator,
+             typename = typename enable_if<!is_integral<InputIterator>::value>::type>
+    BasicByteArray(InputIterator first, InputIterator last)
         : Base(first, last) {}
-#endif
 
-    explicit ByteArray(const char* data, int size = -1)
+    BasicByteArray(initializer_list<char> init)
+        : Base(init) {}
+
+    explicit BasicByteArray(const char* data, int size = -1)
         : Base(data, data + (size < 0 ? strlen(data) : size)) {}
 
-    explicit ByteArray(const string& data)
+    explicit BasicByteArray(const string& data)
         : Base(data.begin(), data.end()) {}
 
     // Allow implicit conversion
     operator string() const  { return to_string(); }
+    operator vector<char>() const { return vector<char>(this->begin(), this->end()); }
 
-    string to_string() const { return string(begin(), end()); }
+    string to_string() const { return string(this->begin(), this->end()); }
 
-    ByteArray& append(const ByteArray& data) {
-        insert(end(), data.begin(), data.end());
+    BasicByteArray& append(const BasicByteArray& data) {
+        this->insert(this->end(), data.begin(), data.end());
         return *this;
     }
 
-    ByteArray& append(const string& data) {
-        insert(end(), data.begin(), data.end());
+    BasicByteArray& append(const string& data) {
+        this->insert(this->end(), data.begin(), data.end());
         return *this;
     }
 
-    ByteArray& append(const char* data, int size) {
-        insert(end(), data, data + (size < 0 ? strlen(data) : size));
+    BasicByteArray& append(const char* data, int size) {
+        this->insert(this->end(), data, data + (size < 0 ? strlen(data) : size));
         return *this;
     }
 
-    ByteArray& append(char byte) {
-        push_back(byte);
+    BasicByteArray& append(char byte) {
+        this->push_back(byte);
         return *this;
     };
 
-    ByteArray& operator+=(const ByteArray& data) { return append(data); };
-    ByteArray& operator+=(const string& data)    { return append(data); };
-    ByteArray& operator+=(const char* data)      { return append(data, -1); };
-    ByteArray& operator+=(char byte)             { return append(byte); };
+    BasicByteArray& operator+=(const BasicByteArray& data) { return append(data); };
+    BasicByteArray& operator+=(const string& data)         { return append(data); };
+    BasicByteArray& operator+=(const char* data)           { return append(data, -1); };
+    BasicByteArray& operator+=(char byte)                  { return append(byte); };
 
-    void fill(char byte) { assign(size(), byte); };
+    void fill(char byte) { this->assign(this->size(), byte); };
 
-    ByteArray sub(int pos, int len = -1) const {
-        auto begin_iter = begin() + pos;
-        return ByteArray(begin_iter, len < 0 ? end() : begin_iter + len);
+    BasicByteArray sub(int pos, int len = -1) const {
+        auto begin_iter = this->begin() + pos;
+        return BasicByteArray(begin_iter, len < 0 ? this->end() : begin_iter + len);
     };
+
+    void resize(size_t n)            { Base::resize(n, char()); }
+    void resize(size_t n, char byte) { Base::resize(n, byte); }
+
+    // Resize without clearing the new bytes
+    void resize_uninitialized(size_t n) { Base::resize(n); }
+
+    // Grow by n uninitialized bytes and return a pointer to them. Write the data there
+    // and shrink the array with resize() if less than n bytes were produced.
+    char* reserve_for_write(size_t n) {
+        auto old_size = this->size();
+        resize_uninitialized(old_size + n);
+        return this->data() + old_size;
+    }
 };
 
-inline ByteArray operator+(const ByteArray& left, const ByteArray& right)
+using ByteArray = BasicByteArray<>;
+
+// Non-owning read-only view of contiguous bytes, the referenced data must outlive the view
+class ByteView {
+public:
+    using value_type     = char;
+    using iterator       = const char*;
+    using const_iterator = const char*;
+
+    ByteView() : ptr(nullptr), len(0) {}
+    ByteView(const char* data, size_t size) : ptr(data), len(size) {}
+    template<typename Alloc>
+    ByteView(const BasicByteArray<Alloc>& data) : ptr(data.data()), len(data.size()) {}
+    ByteView(const string& data) : ptr(data.data()), len(data.size()) {}
+
+    const char* data() const { return ptr; }
+    size_t size() const      { return len; }
+    bool empty() const       { return len == 0; }
+
+    const char* begin() const { return ptr; }
+    const char* end() const   { return ptr + len; }
+
+    char operator[](size_t idx) const { return ptr[idx]; }
+
+    string to_string() const       { return string(ptr, len); }
+    ByteArray toByteArray() const  { return ByteArray(ptr, ptr + len); }
+
+    // Like string::substr, but a pos past the end gives an empty view at the end
+    ByteView sub(size_t pos, size_t count = size_t(-1)) const {
+        pos = min(pos, len);
+        return ByteView(ptr + pos, min(count, len - pos));
+    }
+
+private:
+    const char* ptr;
+    size_t len;
+};
+
+inline bool operator==(const ByteView& left, const ByteView& right)
+{
+    return left.size() == right.size() &&
+           (left.size() == 0 || memcmp(left.data(), right.data(), left.size()) == 0);
+}
+
+inline bool operator!=(const ByteView& left, const ByteView& right)
+{
+    return !(left == right);
+}
+
+template<typename Alloc>
+inline BasicByteArray<Alloc> operator+(const BasicByteArray<Alloc>& left,
+                                       const BasicByteArray<Alloc>& right)
 {
-    ByteArray result(left);
+    BasicByteArray<Alloc> result(left);
     return result += right;
 }
 
-inline bool operator==(const ByteArray& left, const ByteArray& right)
+template<typename Alloc>
+inline bool operator==(const BasicByteArray<Alloc>& left, const BasicByteArray<Alloc>& right)
 {
     return left.size() == right.size() &&
            equal(left.begin(), left.end(), right.begin());
 }
 
-inline bool operator!=(const ByteArray& left, const ByteArray& right)
+template<typename Alloc>
+inline bool operator!=(const BasicByteArray<Alloc>& left, const BasicByteArray<Alloc>& right)
 {
     return !(left == right);
 }
 
-inline ostream& operator<<(ostream& os, const ByteArray& byte_arr)
+template<typename Alloc>
+inline ostream& operator<<(ostream& os, const BasicByteArray<Alloc>& byte_arr)
 {
     stringstream ss;
     ss.flags(ios::right | ios::hex);
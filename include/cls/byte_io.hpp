@@ -0,0 +1,269 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_BYTE_IO_HPP
+#define CLS_BYTE_IO_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "byte_array.hpp"
+#include "endian.hpp"
+
+_CLS_BEGIN
+inline uint64_t zigzagEncode(int64_t val)
+{
+    return (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t val)
+{
+    return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Append binary encoded values to a byte array.
+// The writer grows the array ahead of the written data so that every fixed width put
+// is a capacity check plus one store. The array is trimmed to the written size by
+// flush() and on destruction, don't use it in between.
+class ByteWriter {
+public:
+    explicit ByteWriter(ByteArray& buffer, size_t reserve_hint = 0)
+        : buf(buffer), pos(buffer.size()) {
+        reserve(reserve_hint);
+    }
+
+    ByteWriter(const ByteWriter&) = delete;
+    ByteWriter& operator=(const ByteWriter&) = delete;
+
+    ~ByteWriter() { flush(); }
+
+    // Make room for at least n more bytes without regrowth
+    void reserve(size_t n) {
+        if (buf.size() - pos < n) grow(n);
+    }
+
+    template<typename T>
+    ByteWriter& putLE(T val) {
+        storeLE(claim(sizeof(T)), val);
+        return *this;
+    }
+
+    template<typename T>
+    ByteWriter& putBE(T val) {
+        storeBE(claim(sizeof(T)), val);
+        return *this;
+    }
+
+    // Unsigned LEB128
+    ByteWriter& putVarint(uint64_t val) {
+        auto ptr = buf.data() + pos;
+        if (buf.size() - pos < 10) ptr = reserveAt(10);
+        auto start = ptr;
+        while (val >= 0x80) {
+            *ptr++ = static_cast<char>(val | 0x80);
+            val >>= 7;
+        }
+        *ptr++ = static_cast<char>(val);
+        pos += ptr - start;
+        return *this;
+    }
+
+    // Signed LEB128 of the zigzag encoded value, small magnitudes take few bytes
+    ByteWriter& putZigzag(int64_t val) {
+        return putVarint(zigzagEncode(val));
+    }
+
+    ByteWriter& putBytes(ByteView data) {
+        if (!data.empty()) memcpy(claim(data.size()), data.data(), data.size());
+        return *this;
+    }
+
+    // Bulk copy of trivially copyable elements in host layout
+    template<typename T>
+    ByteWriter& putSpan(const T* data, size_t count) {
+        static_assert(is_trivially_copyable<T>::value, "putSpan requires trivially copyable type");
+        if (count) memcpy(claim(count * sizeof(T)), data, count * sizeof(T));
+        return *this;
+    }
+
+    template<typename T>
+    ByteWriter& putSpan(const vector<T>& data) {
+        return putSpan(data.data(), data.size());
+    }
+
+    // Number of bytes in the buffer including the ones written before the writer
+    size_t size() const { return pos; }
+
+    void flush() { buf.resize(pos); }
+
+private:
+    char* claim(size_t n) {
+        if (buf.size() - pos < n) grow(n);
+        auto ptr = buf.data() + pos;
+        pos += n;
+        return ptr;
+    }
+
+    char* reserveAt(size_t n) {
+        grow(n);
+        return buf.data() + pos;
+    }
+
+    void grow(size_t n) {
+        buf.resize_uninitialized(max(pos + n, max<size_t>(2 * buf.size(), 64)));
+    }
+
+    ByteArray& buf;
+    size_t pos;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Decode binary values from a byte view. Reads never throw, a read past the end or a
+// malformed varint sets a sticky error, leaves the position unchanged and yields a
+// value initialized result. Check ok() once after a group of reads.
+class ByteReader {
+public:
+    enum class Error { None, OutOfRange, BadVarint };
+
+    explicit ByteReader(ByteView data)
+        : first(data.data()), cur(data.data()), last(data.data() + data.size()),
+          err(Error::None) {}
+
+    template<typename T>
+    bool getLE(T& val) {
+        if (!check(sizeof(T))) return val = T(), false;
+        val  = loadLE<T>(cur);
+        cur += sizeof(T);
+        return true;
+    }
+
+    template<typename T>
+    bool getBE(T& val) {
+        if (!check(sizeof(T))) return val = T(), false;
+        val  = loadBE<T>(cur);
+        cur += sizeof(T);
+        return true;
+    }
+
+    template<typename T>
+    T getLE() {
+        T val;
+        getLE(val);
+        return val;
+    }
+
+    template<typename T>
+    T getBE() {
+        T val;
+        getBE(val);
+        return val;
+    }
+
+    bool getVarint(uint64_t& val) {
+        val = 0;
+        auto ptr = cur;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (ptr == last) return fail(Error::OutOfRange);
+            auto byte = static_cast<uchar>(*ptr++);
+            // The 10th byte may only carry the top bit of a 64-bit value
+            if (shift == 63 && byte > 1) return fail(Error::BadVarint);
+            val |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                cur = ptr;
+                return true;
+            }
+        }
+        val = 0;
+        return fail(Error::BadVarint);
+    }
+
+    bool getZigzag(int64_t& val) {
+        uint64_t raw;
+        bool success = getVarint(raw);
+        val = zigzagDecode(raw);
+        return success;
+    }
+
+    uint64_t getVarint() {
+        uint64_t val;
+        getVarint(val);
+        return val;
+    }
+
+    int64_t getZigzag() {
+        int64_t val;
+        getZigzag(val);
+        return val;
+    }
+
+    // View of the next n bytes, no copy is made
+    bool getBytes(size_t n, ByteView& data) {
+        if (!check(n)) return data = ByteView(), false;
+        data = ByteView(cur, n);
+        cur += n;
+        return true;
+    }
+
+    template<typename T>
+    bool getSpan(T* data, size_t count) {
+        static_assert(is_trivially_copyable<T>::value, "getSpan requires trivially copyable type");
+        if (count > size_t(last - cur) / sizeof(T)) return fail(Error::OutOfRange);
+        if (count) memcpy(data, cur, count * sizeof(T));
+        cur += count * sizeof(T);
+        return true;
+    }
+
+    bool skip(size_t n) {
+        if (!check(n)) return false;
+        cur += n;
+        return true;
+    }
+
+    size_t position() const  { return cur - first; }
+    size_t remaining() const { return last - cur; }
+    bool   atEnd() const     { return cur == last; }
+
+    bool  ok() const    { return err == Error::None; }
+    Error error() const { return err; }
+    void  clearError()  { err = Error::None; }
+
+private:
+    bool check(size_t n) {
+        return size_t(last - cur) >= n || fail(Error::OutOfRange);
+    }
+
+    bool fail(Error error) {
+        if (err == Error::None) err = error;
+        return false;
+    }
+
+    const char* first;
+    const char* cur;
+    const char* last;
+    Error err;
+};
+_CLS_END
+
+#endif // CLS_BYTE_IO_HPP
@@ -0,0 +1,292 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_CHUNKER_HPP
+#define CLS_CHUNKER_HPP
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <istream>
+#include <fstream>
+#include <stdexcept>
+#include "byte_array.hpp"
+#include "byte_io.hpp"
+#include "hash.hpp"
+
+_CLS_BEGIN
+namespace detail {
+// Gear table of the rolling hash. Chunk boundaries depend on it, so the generator and
+// seed must never change or previously stored chunks stop matching.
+inline const uint64_t* gearTable()
+{
+    static const struct Table {
+        Table() {
+            uint64_t state = 0x636C734765617221ULL;     // "clsGear!"
+            for (auto& val : data) {
+                // splitmix64
+                uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+                z   = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z   = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                val = z ^ (z >> 31);
+            }
+        }
+        uint64_t data[256];
+    } table;
+
+    return table.data;
+}
+
+inline int log2Floor(size_t val)
+{
+    int bits = 0;
+    while (val >>= 1) ++bits;
+    return bits;
+}
+} // End namespace detail
+
+struct ChunkerOptions {
+    size_t min_size = 2 << 10;
+    size_t avg_size = 8 << 10;
+    size_t max_size = 64 << 10;
+};
+
+struct Chunk {
+    uint64_t offset;    // Position in the input
+    size_t   size;
+    uint64_t hash;      // hash64() of the content
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Content defined chunking with the FastCDC algorithm: a Gear rolling hash over each
+// byte, no cut point before min_size, a stricter mask until avg_size and a looser one
+// after it (normalized chunking), and a forced cut at max_size. Inserting or removing
+// bytes only changes the chunks around the edit, so unchanged data dedups.
+class Chunker {
+public:
+    explicit Chunker(const ChunkerOptions& options = ChunkerOptions())
+        : opts(options) {
+        if (opts.min_size == 0 || opts.min_size > opts.avg_size || opts.avg_size > opts.max_size) {
+#if CLS_HAS_EXCEPT
+            throw invalid_argument("Chunk sizes must satisfy 0 < min <= avg <= max");
+#else
+            cerr << "Invalid chunk sizes" << endl;
+            opts = ChunkerOptions();
+#endif
+        }
+        // Normalization level 2: two bits more/less than the average needs
+        auto bits  = detail::log2Floor(opts.avg_size);
+        mask_small = ~0ULL << (64 - min(bits + 2, 63));
+        mask_large = ~0ULL << (64 - max(bits - 2, 1));
+    }
+
+    const ChunkerOptions& options() const { return opts; }
+
+    // Length of the chunk starting at data. If it equals size and size is less than
+    // max_size, no cut point was found and the chunk continues if more data follows.
+    size_t cut(const char* data, size_t size) const {
+        if (size <= opts.min_size) return size;
+        if (size > opts.max_size) size = opts.max_size;
+        auto normal = min(opts.avg_size, size);
+
+        auto gear  = detail::gearTable();
+        auto bytes = reinterpret_cast<const uchar*>(data);
+        uint64_t fp = 0;
+        size_t idx  = opts.min_size;
+        for (; idx < normal; ++idx) {
+            fp = (fp << 1) + gear[bytes[idx]];
+            if (!(fp & mask_small)) return idx + 1;
+        }
+        for (; idx < size; ++idx) {
+            fp = (fp << 1) + gear[bytes[idx]];
+            if (!(fp & mask_large)) return idx + 1;
+        }
+        return size;
+    }
+
+    vector<Chunk> split(ByteView data) const {
+        vector<Chunk> chunks;
+        chunks.reserve(data.size() / opts.avg_size + 1);
+        split(data, [&chunks](const Chunk& chunk, ByteView) {
+            chunks.push_back(chunk);
+        });
+        return chunks;
+    }
+
+    // Call func(const Chunk&, ByteView content) for each chunk of data
+    template<typename Func>
+    void split(ByteView data, Func func) const {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            auto len     = cut(data.data() + pos, data.size() - pos);
+            auto content = data.sub(pos, len);
+            func(Chunk{pos, len, hash64(content)}, content);
+            pos += len;
+        }
+    }
+
+    // Chunk a stream through a fixed size buffer, func is called as for split(). The
+    // content view is only valid during the call.
+    template<typename Func>
+    void split(istream& is, Func func, size_t buffer_size = 4 << 20) const {
+        ByteArray buffer;
+        buffer.resize_uninitialized(max(buffer_size, 2 * opts.max_size));
+
+        uint64_t offset = 0;
+        size_t begin = 0, end = 0;
+        bool eof = false;
+        for (;;) {
+            if (!eof && end - begin < opts.max_size) {
+                // Move the unprocessed tail to the front and refill
+                memmove(buffer.data(), buffer.data() + begin, end - begin);
+                end  -= begin;
+                begin = 0;
+                is.read(buffer.data() + end, buffer.size() - end);
+                end += static_cast<size_t>(is.gcount());
+                eof  = !is;
+            }
+            if (begin == end) break;
+
+            auto len     = cut(buffer.data() + begin, end - begin);
+            auto content = ByteView(buffer.data() + begin, len);
+            func(Chunk{offset, len, hash64(content)}, content);
+            begin  += len;
+            offset += len;
+        }
+    }
+
+    template<typename Func>
+    void splitFile(const string& file_name, Func func) const {
+        ifstream ifs(file_name, ios::binary);
+        if (!ifs) {
+#if CLS_HAS_EXCEPT
+            throw runtime_error("Could not open file " + file_name);
+#else
+            cerr << "Fail to open the file" << endl;
+            return;
+#endif
+        }
+        split(ifs, func);
+    }
+
+private:
+    ChunkerOptions opts;
+    uint64_t mask_small;
+    uint64_t mask_large;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Index of unique chunks keyed by their 64-bit content hash. The location is whatever
+// the caller uses to find the stored copy again, e.g. an offset in a chunk store.
+// Chunks with equal hash and size are treated as identical.
+class ChunkIndex {
+public:
+    struct Entry {
+        uint64_t location;
+        uint64_t size;
+        uint64_t refs;
+    };
+
+    // Add a reference to the chunk. Returns the entry and true if the chunk was new,
+    // in which case location is recorded for it.
+    pair<const Entry*, bool> add(const Chunk& chunk, uint64_t location) {
+        total_bytes += chunk.size;
+        auto result = entries.emplace(chunk.hash, Entry{location, chunk.size, 0});
+        auto& entry = result.first->second;
+#if CLS_HAS_EXCEPT
+        if (entry.size != chunk.size) throw runtime_error("Chunk hash collision");
+#endif
+        ++entry.refs;
+        if (result.second) unique_bytes += chunk.size;
+        return {&entry, result.second};
+    }
+
+    const Entry* find(uint64_t hash) const {
+        auto iter = entries.find(hash);
+        return iter == entries.end() ? nullptr : &iter->second;
+    }
+
+    bool contains(uint64_t hash) const { return entries.count(hash) != 0; }
+
+    size_t size() const { return entries.size(); }
+
+    // Bytes added in total and bytes of distinct chunks
+    uint64_t totalBytes() const  { return total_bytes; }
+    uint64_t uniqueBytes() const { return unique_bytes; }
+
+    void reserve(size_t n) { entries.reserve(n); }
+
+    ByteArray toByteArray() const {
+        ByteArray data;
+        ByteWriter writer(data, 16 + entries.size() * 32);
+        writer.putLE<uint64_t>(total_bytes).putLE<uint64_t>(entries.size());
+        for (const auto& item : entries) {
+            writer.putLE(item.first).putLE(item.second.location)
+                  .putLE(item.second.size).putLE(item.second.refs);
+        }
+        writer.flush();
+        return data;
+    }
+
+    // Returns false and leaves the index empty if data is malformed
+    bool fromByteArray(ByteView data) {
+        clear();
+        ByteReader reader(data);
+        total_bytes = reader.getLE<uint64_t>();
+        auto count  = reader.getLE<uint64_t>();
+        if (!reader.ok() || count > reader.remaining() / 32) return clear(), false;
+
+        entries.reserve(static_cast<size_t>(count));
+        for (uint64_t i = 0; i < count; ++i) {
+            auto hash = reader.getLE<uint64_t>();
+            Entry entry;
+            reader.getLE(entry.location);
+            reader.getLE(entry.size);
+            reader.getLE(entry.refs);
+            unique_bytes += entry.size;
+            entries.emplace(hash, entry);
+        }
+        if (!reader.ok()) return clear(), false;
+        return true;
+    }
+
+    void clear() {
+        entries.clear();
+        total_bytes  = 0;
+        unique_bytes = 0;
+    }
+
+private:
+    // Keys are hash values already, use them as they are
+    struct IdentityHash {
+        size_t operator()(uint64_t key) const { return static_cast<size_t>(key); }
+    };
+
+    unordered_map<uint64_t, Entry, IdentityHash> entries;
+    uint64_t total_bytes  = 0;
+    uint64_t unique_bytes = 0;
+};
+_CLS_END
+
+#endif // CLS_CHUNKER_HPP
@@ -126,6 +126,31 @@ using llong  = long long;
 #define CPP11_SUPPORT (GCC_VERSION >= 408 || CLANG_VERSION >= 303 || _MSC_VER >= 1900)
 #define CPP14_SUPPORT (GCC_VERSION >= 500 || CLANG_VERSION >= 304 || _MSC_VER >= 1900)
 
+// Detect instruction sets enabled at compile time
+#if defined __SSE4_2__ || (defined _MSC_VER && defined __AVX__)
+#  define CLS_HAS_SSE42 1
+#else
+#  define CLS_HAS_SSE42 0
+#endif
+
+#if defined __SSSE3__ || (defined _MSC_VER && defined __AVX__)
+#  define CLS_HAS_SSSE3 1
+#else
+#  define CLS_HAS_SSSE3 0
+#endif
+
+#if defined __AVX2__
+#  define CLS_HAS_AVX2 1
+#else
+#  define CLS_HAS_AVX2 0
+#endif
+
+#if defined __BMI2__
+#  define CLS_HAS_BMI2 1
+#else
+#  define CLS_HAS_BMI2 0
+#endif
+
 _CLS_BEGIN
 using namespace std;
 _CLS_END
@@ -0,0 +1,592 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_COMPRESS_HPP
+#define CLS_COMPRESS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <future>
+#include "byte_array.hpp"
+#include "endian.hpp"
+#include "hash.hpp"
+#include "thread_pool.hpp"
+
+_CLS_BEGIN
+class CompressError : public runtime_error {
+public:
+    explicit CompressError(const string& err_msg)
+        : runtime_error(err_msg) {}
+};
+
+namespace detail {
+// Constants of the LZ4 block format
+const size_t LZ_MIN_MATCH     = 4;
+const size_t LZ_MF_LIMIT      = 12;     // A match may not start within the last 12 bytes
+const size_t LZ_LAST_LITERALS = 5;      // The last 5 bytes are always literals
+const size_t LZ_MAX_DISTANCE  = 65535;
+const int    LZ_HASH_LOG      = 12;
+const int    LZ_SKIP_SHIFT    = 6;
+
+inline uint32_t lzRead32(const char* ptr)
+{
+    uint32_t val;
+    memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+inline uint32_t lzHash(uint32_t seq)
+{
+    return (seq * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+// Length of the common prefix of a and b, b + result never exceeds limit
+inline size_t lzMatchLength(const char* a, const char* b, const char* limit)
+{
+    auto start = b;
+    while (b + 8 <= limit) {
+        uint64_t va, vb;
+        memcpy(&va, a, 8);
+        memcpy(&vb, b, 8);
+        if (auto diff = va ^ vb) {
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return b - start + __builtin_clzll(diff) / 8;
+#elif defined _MSC_VER
+            unsigned long idx;
+            _BitScanForward64(&idx, diff);
+            return b - start + idx / 8;
+#else
+            return b - start + __builtin_ctzll(diff) / 8;
+#endif
+        }
+        a += 8;
+        b += 8;
+    }
+    while (b < limit && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return b - start;
+}
+
+inline char* lzWriteLength(char* op, size_t len)
+{
+    for (; len >= 255; len -= 255) *op++ = char(255);
+    *op++ = static_cast<char>(len);
+    return op;
+}
+
+[[noreturn]] inline void lzFail(const string& msg)
+{
+#if CLS_HAS_EXCEPT
+    throw CompressError(msg);
+#else
+    cerr << msg << endl;
+    abort();
+#endif
+}
+} // End namespace detail
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// LZ4 compatible block codec
+
+// Worst case size of a compressed block
+inline size_t lzCompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// Compress src into dst, return the compressed size or 0 if dst is too small.
+// Higher acceleration trades compression ratio for speed, 1 is the default.
+inline size_t lzCompressBlock(const char* src, size_t src_size,
+                              char* dst, size_t dst_capacity, int acceleration = 1)
+{
+    using namespace detail;
+
+    if (acceleration < 1) acceleration = 1;
+    auto op      = dst;
+    auto op_end  = dst + dst_capacity;
+    auto anchor  = src;
+    auto src_end = src + src_size;
+
+    if (src_size > LZ_MF_LIMIT) {
+        vector<uint32_t> table(size_t(1) << LZ_HASH_LOG, 0);
+        auto ip           = src + 1;
+        auto match_limit  = src_end - LZ_MF_LIMIT;
+        auto extend_limit = src_end - LZ_LAST_LITERALS;
+
+        for (;;) {
+            // Find a match, step size grows the longer no match is found
+            const char* ref;
+            size_t search_count = size_t(acceleration) << LZ_SKIP_SHIFT;
+            for (;;) {
+                if (ip > match_limit) goto last_literals;
+                auto seq  = lzRead32(ip);
+                auto& pos = table[lzHash(seq)];
+                ref = src + pos;
+                pos = static_cast<uint32_t>(ip - src);
+                if (size_t(ip - ref) <= LZ_MAX_DISTANCE && lzRead32(ref) == seq) break;
+                ip += search_count++ >> LZ_SKIP_SHIFT;
+            }
+
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                --ip;
+                --ref;
+            }
+            auto match_len = LZ_MIN_MATCH +
+                             lzMatchLength(ref + LZ_MIN_MATCH, ip + LZ_MIN_MATCH, extend_limit);
+
+            // Emit the sequence: token, literals, offset and match length
+            size_t lit_len = ip - anchor;
+            if (op + 1 + lit_len / 255 + 1 + lit_len + 2 + match_len / 255 + 1 > op_end) return 0;
+            auto token = op++;
+            if (lit_len >= 15) {
+                *token = char(15 << 4);
+                op = lzWriteLength(op, lit_len - 15);
+            } else {
+                *token = static_cast<char>(lit_len << 4);
+            }
+            memcpy(op, anchor, lit_len);
+            op += lit_len;
+
+            auto offset = static_cast<uint32_t>(ip - ref);
+            *op++ = static_cast<char>(offset);
+            *op++ = static_cast<char>(offset >> 8);
+
+            auto extra_len = match_len - LZ_MIN_MATCH;
+            if (extra_len >= 15) {
+                *token |= 15;
+                op = lzWriteLength(op, extra_len - 15);
+            } else {
+                *token |= static_cast<char>(extra_len);
+            }
+
+            ip    += match_len;
+            anchor = ip;
+            if (ip > match_limit) break;
+            table[lzHash(lzRead32(ip - 2))] = static_cast<uint32_t>(ip - 2 - src);
+        }
+    }
+
+last_literals:
+    size_t lit_len = src_end - anchor;
+    if (op + 1 + lit_len / 255 + 1 + lit_len > op_end) return 0;
+    if (lit_len >= 15) {
+        *op++ = char(15 << 4);
+        op = detail::lzWriteLength(op, lit_len - 15);
+    } else {
+        *op++ = static_cast<char>(lit_len << 4);
+    }
+    memcpy(op, anchor, lit_len);
+    op += lit_len;
+
+    return op - dst;
+}
+
+// Decompress a block, return the decompressed size or -1 if the input is malformed
+// or does not fit into dst. Never reads or writes outside the given buffers.
+inline ptrdiff_t lzDecompressBlock(const char* src, size_t src_size,
+                                   char* dst, size_t dst_capacity)
+{
+    auto ip      = reinterpret_cast<const uchar*>(src);
+    auto ip_end  = ip + src_size;
+    auto op      = dst;
+    auto op_end  = dst + dst_capacity;
+
+    auto read_length = [&ip, ip_end](size_t& len) {
+        uchar byte;
+        do {
+            if (ip == ip_end) return false;
+            byte = *ip++;
+            len += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (ip < ip_end) {
+        uchar token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len < 15 && ip_end - ip >= 16 && op_end - op >= 16) {
+            // Short literal run, one fixed size copy is cheaper than an exact one
+            memcpy(op, ip, 16);
+        } else {
+            if (lit_len == 15 && !read_length(lit_len)) return -1;
+            if (size_t(ip_end - ip) < lit_len || size_t(op_end - op) < lit_len) return -1;
+            memcpy(op, ip, lit_len);
+        }
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == ip_end) break;    // Last sequence has no match
+
+        if (ip_end - ip < 2) return -1;
+        size_t offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > size_t(op - dst)) return -1;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && !read_length(match_len)) return -1;
+        match_len += detail::LZ_MIN_MATCH;
+        if (size_t(op_end - op) < match_len) return -1;
+
+        // Copying forward in 8 byte steps keeps an overlapping pattern intact as long as
+        // the offset is at least 8, the copy may overrun the match end if there is room
+        auto ref = op - offset;
+        auto end = op + match_len;
+        if (offset >= 8 && op_end - end >= 8) {
+            do {
+                memcpy(op, ref, 8);
+                op  += 8;
+                ref += 8;
+            } while (op < end);
+        } else if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+        } else {
+            while (op < end) *op++ = *ref++;
+        }
+        op = end;
+    }
+
+    return op - dst;
+}
+
+inline ByteArray lzCompress(ByteView src, int acceleration = 1)
+{
+    ByteArray dst;
+    dst.resize_uninitialized(lzCompressBound(src.size()));
+    auto size = lzCompressBlock(src.data(), src.size(), dst.data(), dst.size(), acceleration);
+    dst.resize(size);
+    return dst;
+}
+
+// raw_size is the exact size of the original data
+inline ByteArray lzDecompress(ByteView src, size_t raw_size)
+{
+    ByteArray dst;
+    dst.resize_uninitialized(raw_size);
+    auto size = lzDecompressBlock(src.data(), src.size(), dst.data(), dst.size());
+    if (size != ptrdiff_t(raw_size)) detail::lzFail("Corrupted LZ block");
+    return dst;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Frame format made of independently compressed blocks:
+//   magic "CLZ1", flags byte, log2 of block size byte,
+//   per block a little endian uint32 size (high bit set if stored uncompressed) and data,
+//   a zero uint32 end mark, then the CRC-32C of the content if the checksum flag is set.
+// Every block except the last holds exactly block size bytes of content.
+struct LzOptions {
+    int  acceleration = 1;
+    int  block_log    = 22;     // 4 MB blocks, valid range is [16, 30]
+    bool checksum     = true;
+};
+
+namespace detail {
+const char   LZ_FRAME_MAGIC[4]    = {'C', 'L', 'Z', '1'};
+const size_t LZ_FRAME_HEADER_SIZE = 6;
+const uchar  LZ_FLAG_CHECKSUM     = 0x01;
+const uint32_t LZ_RAW_BLOCK_BIT   = 0x80000000u;
+
+inline void lzWriteFrameHeader(ByteArray& out, const LzOptions& opts)
+{
+    out.append(LZ_FRAME_MAGIC, 4);
+    out.append(static_cast<char>(opts.checksum ? LZ_FLAG_CHECKSUM : 0));
+    out.append(static_cast<char>(opts.block_log));
+}
+
+// Append one block, falls back to storing it raw when compression doesn't pay off
+inline void lzWriteFrameBlock(ByteArray& out, const char* data, size_t size, int acceleration)
+{
+    auto header_pos = out.size();
+    out.resize_uninitialized(header_pos + 4 + lzCompressBound(size));
+
+    auto body  = out.data() + header_pos + 4;
+    auto csize = lzCompressBlock(data, size, body, out.size() - header_pos - 4, acceleration);
+    uint32_t header;
+    if (csize == 0 || csize >= size) {
+        memcpy(body, data, size);
+        csize  = size;
+        header = static_cast<uint32_t>(size) | LZ_RAW_BLOCK_BIT;
+    } else {
+        header = static_cast<uint32_t>(csize);
+    }
+    storeLE<uint32_t>(out.data() + header_pos, header);
+    out.resize(header_pos + 4 + csize);
+}
+
+inline void lzCheckOptions(const LzOptions& opts)
+{
+    if (opts.block_log < 16 || opts.block_log > 30) lzFail("Invalid LZ block size");
+}
+} // End namespace detail
+
+// Streaming frame encoder, output is appended to the given byte array as soon as a
+// block is filled. The header is written by the first call to write() or finish().
+class LzFrameEncoder {
+public:
+    explicit LzFrameEncoder(const LzOptions& options = LzOptions())
+        : opts(options), block_size(size_t(1) << options.block_log), started(false) {
+        detail::lzCheckOptions(opts);
+    }
+
+    void write(ByteView data, ByteArray& out) {
+        start(out);
+        if (opts.checksum) crc.update(data);
+
+        auto ptr = data.data();
+        auto len = data.size();
+        if (!pending.empty()) {
+            auto fill_size = min(len, block_size - pending.size());
+            pending.append(ptr, static_cast<int>(fill_size));
+            ptr += fill_size;
+            len -= fill_size;
+            if (pending.size() < block_size) return;
+            detail::lzWriteFrameBlock(out, pending.data(), pending.size(), opts.acceleration);
+            pending.clear();
+        }
+        for (; len >= block_size; len -= block_size, ptr += block_size) {
+            detail::lzWriteFrameBlock(out, ptr, block_size, opts.acceleration);
+        }
+        pending.append(ptr, static_cast<int>(len));
+    }
+
+    void finish(ByteArray& out) {
+        start(out);
+        if (!pending.empty()) {
+            detail::lzWriteFrameBlock(out, pending.data(), pending.size(), opts.acceleration);
+            pending.clear();
+        }
+        out.resize(out.size() + 4);
+        storeLE<uint32_t>(out.data() + out.size() - 4, 0);
+        if (opts.checksum) {
+            out.resize(out.size() + 4);
+            storeLE<uint32_t>(out.data() + out.size() - 4, crc.value());
+        }
+        started = false;
+        crc.reset();
+    }
+
+private:
+    void start(ByteArray& out) {
+        if (started) return;
+        detail::lzWriteFrameHeader(out, opts);
+        started = true;
+    }
+
+    LzOptions opts;
+    size_t    block_size;
+    bool      started;
+    ByteArray pending;
+    Crc32c    crc;
+};
+
+// Streaming frame decoder, accepts the frame in arbitrary pieces and appends the
+// decoded content of every complete block to the given byte array.
+class LzFrameDecoder {
+public:
+    LzFrameDecoder() : block_size(0), checksum(false), done(false), consumed(0) {}
+
+    void write(ByteView data, ByteArray& out) {
+        if (done) detail::lzFail("Data after the end of LZ frame");
+        input.insert(input.end(), data.begin(), data.end());   // append() takes an int length
+
+        while (!done) {
+            auto avail = input.size() - consumed;
+            auto ptr   = input.data() + consumed;
+            if (block_size == 0) {
+                if (avail < detail::LZ_FRAME_HEADER_SIZE) break;
+                if (memcmp(ptr, detail::LZ_FRAME_MAGIC, 4) != 0) detail::lzFail("Invalid LZ frame magic");
+                checksum = (ptr[4] & detail::LZ_FLAG_CHECKSUM) != 0;
+                int block_log = static_cast<uchar>(ptr[5]);
+                if (block_log < 16 || block_log > 30) detail::lzFail("Invalid LZ block size");
+                block_size = size_t(1) << block_log;
+                consumed  += detail::LZ_FRAME_HEADER_SIZE;
+                continue;
+            }
+
+            if (avail < 4) break;
+            auto header = loadLE<uint32_t>(ptr);
+            if (header == 0) {
+                if (checksum) {
+                    if (avail < 8) break;
+                    if (loadLE<uint32_t>(ptr + 4) != crc.value()) detail::lzFail("LZ frame checksum mismatch");
+                    consumed += 4;
+                }
+                consumed += 4;
+                done = true;
+                break;
+            }
+
+            size_t size = header & ~detail::LZ_RAW_BLOCK_BIT;
+            if (size > lzCompressBound(block_size)) detail::lzFail("Corrupted LZ frame");
+            if (avail < 4 + size) break;
+
+            auto out_pos = out.size();
+            if (header & detail::LZ_RAW_BLOCK_BIT) {
+                if (size > block_size) detail::lzFail("Corrupted LZ frame");
+                out.append(ptr + 4, static_cast<int>(size));
+            } else {
+                out.resize_uninitialized(out_pos + block_size);
+                auto raw = lzDecompressBlock(ptr + 4, size, out.data() + out_pos, block_size);
+                if (raw < 0) detail::lzFail("Corrupted LZ block");
+                out.resize(out_pos + raw);
+            }
+            if (checksum) crc.update(out.data() + out_pos, out.size() - out_pos);
+            consumed += 4 + size;
+        }
+
+        // Drop consumed input once it dominates the buffer
+        if (consumed > input.size() / 2) {
+            input.erase(input.begin(), input.begin() + consumed);
+            consumed = 0;
+        }
+    }
+
+    bool finished() const { return done; }
+
+private:
+    ByteArray input;
+    size_t    block_size;
+    bool      checksum;
+    bool      done;
+    size_t    consumed;
+    Crc32c    crc;
+};
+
+// Compress a whole buffer into a frame, blocks are compressed in parallel on the
+// pool if one is given
+inline ByteArray lzCompressFrame(ByteView src, const LzOptions& opts = LzOptions(),
+                                 ThreadPool* pool = nullptr)
+{
+    detail::lzCheckOptions(opts);
+    if (!pool) {
+        ByteArray out;
+        LzFrameEncoder encoder(opts);
+        encoder.write(src, out);
+        encoder.finish(out);
+        return out;
+    }
+
+    auto block_size = size_t(1) << opts.block_log;
+    auto num_blocks = (src.size() + block_size - 1) / block_size;
+
+    vector<future<ByteArray>> blocks;
+    for (size_t i = 0; i < num_blocks; ++i) {
+        blocks.push_back(pool->submit([&src, &opts, block_size, i] {
+            auto block = src.sub(i * block_size, block_size);
+            ByteArray out;
+            detail::lzWriteFrameBlock(out, block.data(), block.size(), opts.acceleration);
+            return out;
+        }));
+    }
+    auto crc = opts.checksum ? crc32c(src) : 0;
+    waitAll(blocks);
+
+    ByteArray out;
+    detail::lzWriteFrameHeader(out, opts);
+    for (auto& block : blocks) {
+        out += block.get();
+    }
+    out.resize(out.size() + (opts.checksum ? 8 : 4));
+    storeLE<uint32_t>(out.data() + out.size() - (opts.checksum ? 8 : 4), 0);
+    if (opts.checksum) storeLE<uint32_t>(out.data() + out.size() - 4, crc);
+    return out;
+}
+
+// Decompress a whole frame, blocks are decompressed in parallel on the pool if one
+// is given
+inline ByteArray lzDecompressFrame(ByteView src, ThreadPool* pool = nullptr)
+{
+    if (!pool) {
+        ByteArray out;
+        LzFrameDecoder decoder;
+        decoder.write(src, out);
+        if (!decoder.finished()) detail::lzFail("Truncated LZ frame");
+        return out;
+    }
+
+    using namespace detail;
+    if (src.size() < LZ_FRAME_HEADER_SIZE || memcmp(src.data(), LZ_FRAME_MAGIC, 4) != 0) {
+        lzFail("Invalid LZ frame magic");
+    }
+    bool checksum = (src[4] & LZ_FLAG_CHECKSUM) != 0;
+    int block_log = static_cast<uchar>(src[5]);
+    if (block_log < 16 || block_log > 30) lzFail("Invalid LZ block size");
+    auto block_size = size_t(1) << block_log;
+
+    // Locate all blocks first, the content offset of block i is i * block_size
+    vector<pair<size_t, uint32_t>> blocks;
+    size_t pos = LZ_FRAME_HEADER_SIZE;
+    for (;;) {
+        if (src.size() - pos < 4) lzFail("Truncated LZ frame");
+        auto header = loadLE<uint32_t>(src.data() + pos);
+        pos += 4;
+        if (header == 0) break;
+        size_t size = header & ~LZ_RAW_BLOCK_BIT;
+        if (src.size() - pos < size || size > lzCompressBound(block_size)) lzFail("Truncated LZ frame");
+        blocks.emplace_back(pos, header);
+        pos += size;
+    }
+    if (checksum && src.size() - pos < 4) lzFail("Truncated LZ frame");
+
+    ByteArray out;
+    out.resize_uninitialized(blocks.size() * block_size);
+    vector<future<ptrdiff_t>> results;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        results.push_back(pool->submit([&src, &blocks, &out, block_size, i] {
+            auto ptr    = src.data() + blocks[i].first;
+            auto header = blocks[i].second;
+            auto dst    = out.data() + i * block_size;
+            size_t size = header & ~LZ_RAW_BLOCK_BIT;
+            if (header & LZ_RAW_BLOCK_BIT) {
+                if (size > block_size) return ptrdiff_t(-1);
+                memcpy(dst, ptr, size);
+                return ptrdiff_t(size);
+            }
+            return lzDecompressBlock(ptr, size, dst, block_size);
+        }));
+    }
+
+    // All blocks write into out, none may be running when a corrupt one throws
+    waitAll(results);
+    size_t total = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto size = results[i].get();
+        bool is_last = i + 1 == results.size();
+        if (size < 0 || (!is_last && size_t(size) != block_size)) lzFail("Corrupted LZ block");
+        total += size;
+    }
+    out.resize(total);
+
+    if (checksum && loadLE<uint32_t>(src.data() + pos) != crc32c(out)) {
+        lzFail("LZ frame checksum mismatch");
+    }
+    return out;
+}
+_CLS_END
+
+#endif // CLS_COMPRESS_HPP
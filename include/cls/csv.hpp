@@ -0,0 +1,371 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_CSV_HPP
+#define CLS_CSV_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <future>
+#include <limits>
+#include "file_sys.hpp"
+#include "byte_array.hpp"
+#include "bit_ops.hpp"
+#include "thread_pool.hpp"
+
+#if CLS_HAS_AVX2
+#  include <immintrin.h>
+#endif
+
+_CLS_BEGIN
+struct CsvOptions {
+    char delimiter        = ',';
+    char quote            = '"';
+    bool skip_empty_lines = true;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Fast number conversion of a whole field, false if it isn't a number of the type. Plain
+// decimals with up to 19 digits and a small exponent are converted exactly with one
+// multiplication or division (Clinger's fast path), everything else goes through strtod.
+inline bool parseNumber(ByteView text, int64_t& value)
+{
+    auto cur  = text.begin();
+    auto last = text.end();
+    bool negative = cur != last && *cur == '-';
+    if (cur != last && (*cur == '-' || *cur == '+')) ++cur;
+    if (cur == last) return false;
+    uint64_t result = 0;
+    for (; cur != last; ++cur) {
+        auto digit = static_cast<unsigned>(*cur - '0');
+        if (digit > 9 || result > (uint64_t(numeric_limits<int64_t>::max()) + negative - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    value = negative ? static_cast<int64_t>(0 - result) : static_cast<int64_t>(result);
+    return true;
+}
+
+inline bool parseNumber(ByteView text, double& value)
+{
+    static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    auto cur  = text.begin();
+    auto last = text.end();
+    bool negative = cur != last && *cur == '-';
+    if (cur != last && (*cur == '-' || *cur == '+')) ++cur;
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any_digit = false;
+    for (; cur != last && unsigned(*cur - '0') <= 9; ++cur, any_digit = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + unsigned(*cur - '0');
+            digits  += mantissa != 0;
+        } else {
+            ++exponent;
+            digits = 20;    // Not exact any more
+        }
+    }
+    if (cur != last && *cur == '.') {
+        for (++cur; cur != last && unsigned(*cur - '0') <= 9; ++cur, any_digit = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + unsigned(*cur - '0');
+                digits  += mantissa != 0;
+                --exponent;
+            } else {
+                digits = 20;
+            }
+        }
+    }
+    if (any_digit && cur != last && (*cur == 'e' || *cur == 'E')) {
+        auto exp_first = ++cur;
+        bool exp_negative = cur != last && *cur == '-';
+        if (cur != last && (*cur == '-' || *cur == '+')) ++cur;
+        int exp_value = 0;
+        bool exp_digit = false;
+        for (; cur != last && unsigned(*cur - '0') <= 9; ++cur, exp_digit = true) {
+            if (exp_value < 100000) exp_value = exp_value * 10 + (*cur - '0');
+        }
+        if (!exp_digit) cur = exp_first - 1;    // Let strtod judge
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    if (any_digit && cur == last && digits <= 19 && mantissa <= (uint64_t(1) << 53) &&
+        exponent >= -22 && exponent <= 22) {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / pow10[-exponent] : result * pow10[exponent];
+        value  = negative ? -result : result;
+        return true;
+    }
+
+    // Slow path: long mantissas, large exponents, inf and nan
+    if (text.empty() || text.size() > 1023) return false;
+    char buffer[1024];
+    memcpy(buffer, text.data(), text.size());
+    buffer[text.size()] = '\0';
+    char* end = nullptr;
+    value = strtod(buffer, &end);
+    return end == buffer + text.size();
+}
+
+// Fields of one record, views into the parsed text that are valid during the callback.
+// Enclosing quotes are removed, escaped quotes ("") are left in the view and resolved
+// by text().
+class CsvRow {
+public:
+    size_t size() const { return fields.size(); }
+    bool empty() const  { return fields.empty(); }
+
+    ByteView operator[](size_t idx) const { return fields[idx]; }
+    bool quoted(size_t idx) const         { return (quoted_bits[idx / 64] >> (idx % 64)) & 1; }
+
+    string text(size_t idx) const {
+        auto field = fields[idx];
+        if (!quoted(idx) || !memchr(field.data(), quote, field.size())) return field.to_string();
+        string result;
+        result.reserve(field.size());
+        for (size_t i = 0; i < field.size(); ++i) {
+            result += field[i];
+            if (field[i] == quote && i + 1 < field.size() && field[i + 1] == quote) ++i;
+        }
+        return result;
+    }
+
+    template<typename T>
+    bool get(size_t idx, T& value) const { return parseNumber(fields[idx], value); }
+
+    // Begin/end over the field views
+    const ByteView* begin() const { return fields.data(); }
+    const ByteView* end() const   { return fields.data() + fields.size(); }
+
+private:
+    template<typename Func>
+    friend size_t parseCsvRange(const char*, size_t, const CsvOptions&, CsvRow&, Func&);
+
+    void clear() {
+        fields.clear();
+        quoted_bits.clear();
+    }
+
+    void add(const char* first, const char* last) {
+        bool is_quoted = last - first >= 2 && *first == quote && last[-1] == quote;
+        if (fields.size() % 64 == 0) quoted_bits.push_back(0);
+        if (is_quoted) {
+            quoted_bits.back() |= uint64_t(1) << (fields.size() % 64);
+            ++first;
+            --last;
+        }
+        fields.emplace_back(first, static_cast<size_t>(last - first));
+    }
+
+    vector<ByteView> fields;
+    vector<uint64_t> quoted_bits;
+    char quote = '"';
+};
+
+namespace detail {
+// Bit i set where block[i] == byte, for a 64 byte block
+struct CsvMasks {
+    uint64_t quote, delim, newline;
+};
+
+inline CsvMasks csvMasks(const char* block, char quote, char delim)
+{
+    CsvMasks masks;
+#if CLS_HAS_AVX2
+    auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    auto match = [&](char c) {
+        auto pattern = _mm256_set1_epi8(c);
+        return uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, pattern)))) |
+               uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, pattern)))) << 32;
+    };
+    masks.quote   = match(quote);
+    masks.delim   = match(delim);
+    masks.newline = match('\n');
+#else
+    masks.quote = masks.delim = masks.newline = 0;
+    for (int i = 0; i < 64; ++i) {
+        masks.quote   |= uint64_t(block[i] == quote) << i;
+        masks.delim   |= uint64_t(block[i] == delim) << i;
+        masks.newline |= uint64_t(block[i] == '\n') << i;
+    }
+#endif
+    return masks;
+}
+
+// Bit i is the parity of the set bits at or below i: set between an opening quote and
+// its closing quote, an escaped quote pair flips it twice
+inline uint64_t prefixXor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Start of the first record at or after pos, given whether pos is inside quotes
+inline size_t csvRecordStart(const char* data, size_t n, size_t pos, bool in_quotes, char quote)
+{
+    for (; pos < n; ++pos) {
+        if (data[pos] == quote) in_quotes = !in_quotes;
+        else if (data[pos] == '\n' && !in_quotes) return pos + 1;
+    }
+    return n;
+}
+} // End namespace detail
+
+// Split [data, data + n) into records and call func(row) for each, the text must start
+// at a record boundary. The delimiters, newlines and quotes of 64 bytes are found with
+// one compare each; a prefix XOR of the quote bits masks the delimiters and newlines
+// inside quoted fields, and the remaining structural bits are walked with ctz.
+template<typename Func>
+inline size_t parseCsvRange(const char* data, size_t n, const CsvOptions& opts, CsvRow& row, Func& func)
+{
+    size_t records = 0;
+    size_t field_start = 0;
+    uint64_t in_quotes = 0;     // All ones if the previous block ended inside quotes
+    row.quote = opts.quote;
+    row.clear();
+
+    auto end_record = [&](size_t line_end) {
+        auto last = data + line_end;
+        if (last > data + field_start && last[-1] == '\r') --last;
+        row.add(data + field_start, last);
+        if (!(opts.skip_empty_lines && row.size() == 1 && row[0].empty() && !row.quoted(0))) {
+            func(static_cast<const CsvRow&>(row));
+            ++records;
+        }
+        row.clear();
+    };
+
+    char tail[64];
+    for (size_t base = 0; base < n; base += 64) {
+        auto block = data + base;
+        if (n - base < 64) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, block, n - base);
+            block = tail;
+        }
+        auto masks  = detail::csvMasks(block, opts.quote, opts.delimiter);
+        auto inside = detail::prefixXor(masks.quote) ^ in_quotes;
+        in_quotes   = uint64_t(int64_t(inside) >> 63);
+        auto structural = (masks.delim | masks.newline) & ~inside;
+        if (n - base < 64) structural &= (uint64_t(1) << (n - base)) - 1;
+        while (structural) {
+            auto bit = structural & (0 - structural);
+            auto pos = base + ctz(structural);
+            if (masks.newline & bit) {
+                end_record(pos);
+            } else {
+                row.add(data + field_start, data + pos);
+            }
+            field_start = pos + 1;
+            structural ^= bit;
+        }
+    }
+    if (field_start < n || !row.empty()) end_record(n);
+    return records;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// CSV/TSV parser over a memory mapped file or a buffer. for_each() calls func(row) for
+// every record; the parallel overload splits the text into one range per worker at
+// record boundaries found from the quote parity and calls func concurrently, with the
+// records of each range in order. Rows with a single empty field (blank lines) are
+// skipped unless CsvOptions::skip_empty_lines is off.
+class CsvReader {
+public:
+    explicit CsvReader(ByteView data, const CsvOptions& options = CsvOptions())
+        : text(data), opts(options) {}
+
+    explicit CsvReader(const string& file_name, const CsvOptions& options = CsvOptions())
+        : mapped(file_name), text(mapped.view()), opts(options) {
+        mapped.advise(MappedFile::Advice::Sequential);
+    }
+
+    ByteView data() const { return text; }
+
+    // Returns the number of records
+    template<typename Func>
+    size_t for_each(Func func) const {
+        CsvRow row;
+        return parseCsvRange(text.data(), text.size(), opts, row, func);
+    }
+
+    template<typename Func>
+    size_t for_each(ThreadPool& pool, Func func) const {
+        auto n      = text.size();
+        auto chunks = min(pool.size(), max<size_t>(n >> 16, 1));
+        if (chunks < 2) return for_each(func);
+
+        // Quote parity at the nominal chunk starts, then the next record start after each
+        vector<size_t> starts(chunks + 1, n);
+        vector<future<size_t>> quote_counts;
+        for (size_t k = 0; k + 1 < chunks; ++k) {
+            auto first = n * k / chunks, last = n * (k + 1) / chunks;
+            quote_counts.push_back(pool.submit([this, first, last] {
+                return detail::countByte(text.data() + first, last - first, opts.quote);
+            }));
+        }
+        starts[0] = 0;
+        size_t quotes = 0;
+        for (size_t k = 1; k < chunks; ++k) {
+            quotes += quote_counts[k - 1].get();
+            starts[k] = detail::csvRecordStart(text.data(), n, n * k / chunks, quotes % 2 != 0,
+                                               opts.quote);
+        }
+
+        vector<future<size_t>> results;
+        for (size_t k = 0; k < chunks; ++k) {
+            auto first = min(starts[k], n), last = max(first, min(starts[k + 1], n));
+            results.push_back(pool.submit([this, first, last, &func] {
+                CsvRow row;
+                return parseCsvRange(text.data() + first, last - first, opts, row, func);
+            }));
+        }
+        // The ranges use func and this until they finish, even after one has thrown
+        waitAll(results);
+        size_t records = 0;
+        for (auto& result : results) records += result.get();
+        return records;
+    }
+
+private:
+    MappedFile mapped;
+    ByteView text;
+    CsvOptions opts;
+};
+_CLS_END
+
+#endif // CLS_CSV_HPP
@@ -0,0 +1,423 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_DIR_WALK_HPP
+#define CLS_DIR_WALK_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+#include "file_sys.hpp"
+#include "thread_pool.hpp"
+
+#ifndef _WIN32
+#  include <dirent.h>
+#  ifdef __linux__
+#    include <sys/syscall.h>
+#  endif
+#endif
+
+_CLS_BEGIN
+enum class EntryType { File, Directory, Symlink, Other };
+
+// What to do with symbolic links: leave them out, report them without following, or
+// follow them (directory links are entered once, cycles are cut)
+enum class SymlinkPolicy { Skip, Report, Follow };
+
+struct WalkOptions {
+    vector<string> patterns;        // Glob patterns (*, ?, [a-z], [!a]) for file names, any may match
+    vector<string> extensions;      // Extensions such as "txt" or ".txt", case insensitive
+    int  max_depth      = -1;       // Depth 1 is the content of root, -1 for no limit
+    SymlinkPolicy symlinks = SymlinkPolicy::Report;
+    bool include_dirs   = false;    // Report directories too, the filters only apply to files
+    bool skip_hidden    = false;    // Leave out names starting with '.' and don't enter them
+    bool stat           = false;    // Fill DirEntry::info
+    ThreadPool* pool    = nullptr;  // Walk subtrees in parallel on the pool
+};
+
+struct DirEntry {
+    string    path;                 // root + '/' + relative path
+    EntryType type  = EntryType::Other;
+    int       depth = 0;
+    FileInfo  info;                 // Only with WalkOptions::stat
+
+    string name() const { return path.substr(path.find_last_of("/\\") + 1); }
+};
+
+// Shell style match of a whole name: '*' any run, '?' any character, [abc], [a-z], [!a]
+inline bool globMatch(const char* pattern, const char* name)
+{
+    const char* star_pattern = nullptr;
+    const char* star_name    = nullptr;
+    while (*name) {
+        bool matched = false;
+        auto next    = pattern + 1;
+        if (*pattern == '*') {
+            star_pattern = pattern++;
+            star_name    = name;
+            continue;
+        } else if (*pattern == '?') {
+            matched = true;
+        } else if (*pattern == '[') {
+            auto cls    = pattern + 1;
+            bool negate = *cls == '!' || *cls == '^';
+            if (negate) ++cls;
+            bool in_set = false;
+            auto first  = cls;
+            while (*cls && (*cls != ']' || cls == first)) {
+                if (cls[1] == '-' && cls[2] && cls[2] != ']') {
+                    in_set |= uchar(*name) >= uchar(cls[0]) && uchar(*name) <= uchar(cls[2]);
+                    cls += 3;
+                } else {
+                    in_set |= *name == *cls++;
+                }
+            }
+            if (*cls == ']') {
+                matched = in_set != negate;
+                next    = cls + 1;
+            } else {    // No closing bracket, '[' is literal
+                matched = *name == '[';
+            }
+        } else {
+            matched = *pattern == *name;
+        }
+
+        if (*pattern && matched) {
+            pattern = next;
+            ++name;
+        } else if (star_pattern) {  // Let the last '*' take one more character
+            pattern = star_pattern + 1;
+            name    = ++star_name;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') ++pattern;
+    return *pattern == '\0';
+}
+
+inline bool globMatch(const string& pattern, const string& name)
+{
+    return globMatch(pattern.c_str(), name.c_str());
+}
+
+namespace detail {
+struct WalkFilter {
+    explicit WalkFilter(const WalkOptions& opts) : patterns(opts.patterns) {
+        for (auto ext : opts.extensions) {
+            if (ext.empty() || ext[0] != '.') ext.insert(ext.begin(), '.');
+            for (auto& c : ext) c = static_cast<char>(tolower(uchar(c)));
+            extensions.push_back(ext);
+        }
+    }
+
+    bool operator()(const char* name, size_t len) const {
+        if (!extensions.empty() && none_of(extensions.begin(), extensions.end(), [&](const string& ext) {
+                return len >= ext.size() && equal(ext.begin(), ext.end(), name + len - ext.size(),
+                    [](char a, char b) { return a == tolower(uchar(b)); });
+            })) {
+            return false;
+        }
+        return patterns.empty() || any_of(patterns.begin(), patterns.end(), [&](const string& pattern) {
+            return globMatch(pattern.c_str(), name);
+        });
+    }
+
+    vector<string> patterns;
+    vector<string> extensions;
+};
+
+enum class ListStatus {Ok, OpenFailed, ReadFailed};
+
+// Calls func(name, length, type, info) for each entry of the open directory except . and ..
+// With need_stat or an unknown type the entry is stat'ed relative to the directory
+// descriptor, which saves the kernel the path lookup from the root on each call. After a
+// read error the entries listed so far have been reported.
+#ifdef _WIN32
+template<typename Func>
+inline ListStatus listDirectory(const string& path, bool need_stat, bool follow, Func func)
+{
+    WIN32_FIND_DATAA data;
+    auto handle = FindFirstFileA((path + "\\*").c_str(), &data);
+    if (handle == INVALID_HANDLE_VALUE) return ListStatus::OpenFailed;
+    do {
+        auto name = data.cFileName;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) continue;
+        auto attr = data.dwFileAttributes;
+        auto type = (attr & FILE_ATTRIBUTE_REPARSE_POINT) && !follow ? EntryType::Symlink
+                  : (attr & FILE_ATTRIBUTE_DIRECTORY) ? EntryType::Directory : EntryType::File;
+        FileInfo info;
+        if (need_stat) {
+            info.size     = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+            info.mtime_ns = ((int64_t(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                             data.ftLastWriteTime.dwLowDateTime) * 100;
+            info.regular  = type == EntryType::File;
+        }
+        func(name, strlen(name), type, info);
+    } while (FindNextFileA(handle, &data));
+    bool complete = GetLastError() == ERROR_NO_MORE_FILES;
+    FindClose(handle);
+    return complete ? ListStatus::Ok : ListStatus::ReadFailed;
+}
+#else
+inline EntryType entryType(mode_t mode)
+{
+    return S_ISREG(mode) ? EntryType::File : S_ISDIR(mode) ? EntryType::Directory
+         : S_ISLNK(mode) ? EntryType::Symlink : EntryType::Other;
+}
+
+inline void statEntry(int dir_fd, const char* name, bool follow, EntryType& type, FileInfo& info)
+{
+    struct stat st;
+    if (fstatat(dir_fd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0) return;
+    type = entryType(st.st_mode);
+    info.size = static_cast<uint64_t>(st.st_size);
+#  ifdef __APPLE__
+    info.mtime_ns = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#  else
+    info.mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#  endif
+    info.regular = S_ISREG(st.st_mode);
+}
+
+template<typename Func>
+inline ListStatus listDirectory(const string& path, bool need_stat, bool follow, Func func)
+{
+    auto handle_entry = [&](int dir_fd, const char* name, uchar d_type) {
+        if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) return;
+        auto type = d_type == DT_REG ? EntryType::File : d_type == DT_DIR ? EntryType::Directory
+                  : d_type == DT_LNK ? EntryType::Symlink : EntryType::Other;
+        FileInfo info;
+        if (need_stat || d_type == DT_UNKNOWN || (follow && type == EntryType::Symlink)) {
+            statEntry(dir_fd, name, follow, type, info);
+        }
+        func(name, strlen(name), type, info);
+    };
+
+#  if defined __linux__ && defined SYS_getdents64
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return ListStatus::OpenFailed;
+    // linux_dirent64: ino 8, off 8, reclen 2, type 1, name
+    alignas(8) char buffer[64 * 1024];
+    auto status = ListStatus::Ok;
+    while (true) {
+        auto bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0) status = ListStatus::ReadFailed;
+        if (bytes <= 0) break;
+        for (long pos = 0; pos < bytes;) {
+            unsigned short reclen;
+            memcpy(&reclen, buffer + pos + 16, sizeof(reclen));
+            handle_entry(fd, buffer + pos + 19, uchar(buffer[pos + 18]));
+            pos += reclen;
+        }
+    }
+    ::close(fd);
+#  else
+    auto dir = opendir(path.c_str());
+    if (!dir) return ListStatus::OpenFailed;
+    // readdir returns null at the end and on errors, only the latter sets errno
+    errno = 0;
+    while (auto entry = readdir(dir)) {
+        handle_entry(dirfd(dir), entry->d_name, entry->d_type);
+        errno = 0;
+    }
+    auto status = errno ? ListStatus::ReadFailed : ListStatus::Ok;
+    closedir(dir);
+#  endif
+    return status;
+}
+#endif
+
+struct WalkState {
+    mutex state_mutex;
+    condition_variable cond;
+    vector<pair<string, int>> dirs;     // Directories left to list and their depth
+    size_t active = 0;
+    set<pair<uint64_t, uint64_t>> visited;
+    exception_ptr error;
+    atomic<size_t> reported{0};
+};
+
+// Take directories until none are left and no other worker can produce more
+template<typename Func>
+inline void walkWorker(WalkState& state, const WalkOptions& opts, const WalkFilter& filter, Func& func)
+{
+    bool follow = opts.symlinks == SymlinkPolicy::Follow;
+    unique_lock<mutex> lock(state.state_mutex);
+    while (true) {
+        state.cond.wait(lock, [&] { return !state.dirs.empty() || state.active == 0 || state.error; });
+        if (state.dirs.empty() || state.error) {
+            state.cond.notify_all();
+            return;
+        }
+        auto dir = move(state.dirs.back());
+        state.dirs.pop_back();
+        ++state.active;
+        lock.unlock();
+
+        vector<pair<string, int>> subdirs;
+        auto depth   = dir.second + 1;
+        bool descend = opts.max_depth < 0 || depth < opts.max_depth;
+        // Separator only if the directory doesn't end in one already, as root "/" does
+        bool add_slash = dir.first.back() != '/' && dir.first.back() != '\\';
+        try {
+            auto status = listDirectory(dir.first, opts.stat, follow,
+                          [&](const char* name, size_t len, EntryType type, const FileInfo& info) {
+                if (opts.skip_hidden && name[0] == '.') return;
+                if (type == EntryType::Symlink && opts.symlinks == SymlinkPolicy::Skip) return;
+                bool is_dir = type == EntryType::Directory;
+                if (!is_dir && !filter(name, len)) return;
+
+                DirEntry entry;
+                entry.path.reserve(dir.first.size() + 1 + len);
+                entry.path.append(dir.first).append(add_slash ? 1 : 0, '/').append(name, len);
+                entry.type  = type;
+                entry.depth = depth;
+                entry.info  = info;
+                if (is_dir && descend) subdirs.emplace_back(entry.path, depth);
+                if (!is_dir || opts.include_dirs) {
+                    func(move(entry));
+                    ++state.reported;
+                }
+            });
+            // A truncated listing is an error, so is root that can't be opened
+            if (status == ListStatus::ReadFailed || (status == ListStatus::OpenFailed && dir.second == 0)) {
+                auto err_msg = (status == ListStatus::ReadFailed ? "Could not read directory "
+                                                                 : "Could not open directory ") + dir.first;
+#if CLS_HAS_EXCEPT
+                throw FileExcept(err_msg);
+#else
+                cerr << err_msg << endl;
+#endif
+            }
+        } catch (...) {
+            lock.lock();
+            if (!state.error) state.error = current_exception();
+            --state.active;
+            continue;
+        }
+
+#ifndef _WIN32
+        // Followed links can lead back up the tree, enter each directory once
+        if (follow && !subdirs.empty()) {
+            auto last = remove_if(subdirs.begin(), subdirs.end(), [&](const pair<string, int>& sub) {
+                struct stat st;
+                if (::stat(sub.first.c_str(), &st) != 0) return true;
+                lock_guard<mutex> guard(state.state_mutex);
+                return !state.visited.insert({uint64_t(st.st_dev), uint64_t(st.st_ino)}).second;
+            });
+            subdirs.erase(last, subdirs.end());
+        }
+#endif
+
+        lock.lock();
+        --state.active;
+        for (auto& sub : subdirs) state.dirs.push_back(move(sub));
+        if (!subdirs.empty() || state.active == 0) state.cond.notify_all();
+    }
+}
+} // End namespace detail
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Recursively list root and call func(DirEntry&&) for each entry passing the filters,
+// returns the number of entries reported. Directories are read in large batches
+// (getdents64 on Linux). With a pool every worker takes whole directories from a shared
+// stack, so func is called concurrently and must be thread safe, and the order is
+// unspecified. Directories that can't be opened below root are skipped, root itself and
+// read errors in any directory throw FileExcept. Must not be called from a task running
+// on the same pool.
+template<typename Func>
+inline size_t walkDirectory(const string& root, const WalkOptions& opts, Func func)
+{
+    FileInfo root_info;
+    if (!fileInfo(root, root_info) || root_info.regular) {
+#if CLS_HAS_EXCEPT
+        throw FileExcept("Could not open directory " + root);
+#else
+        cerr << "Fail to open the directory" << endl;
+        return 0;
+#endif
+    }
+
+    detail::WalkFilter filter(opts);
+    detail::WalkState state;
+    auto base = root;
+    while (base.size() > 1 && (base.back() == '/' || base.back() == '\\')) base.pop_back();
+    state.dirs.emplace_back(base, 0);
+#ifndef _WIN32
+    struct stat st;
+    if (opts.symlinks == SymlinkPolicy::Follow && ::stat(base.c_str(), &st) == 0) {
+        state.visited.insert({uint64_t(st.st_dev), uint64_t(st.st_ino)});
+    }
+#endif
+
+    if (!opts.pool || opts.pool->size() < 2) {
+        detail::walkWorker(state, opts, filter, func);
+    } else {
+        vector<future<void>> workers;
+        for (size_t i = 0; i < opts.pool->size(); ++i) {
+            workers.push_back(opts.pool->submit([&] {
+                detail::walkWorker(state, opts, filter, func);
+            }));
+        }
+        for (auto& worker : workers) worker.get();
+    }
+    if (state.error) rethrow_exception(state.error);
+    return state.reported;
+}
+
+// Push the entries to a queue and close it at the end, for a consumer on another thread
+inline size_t walkDirectory(const string& root, const WalkOptions& opts, ConcurrentQueue<DirEntry>& queue)
+{
+    struct CloseQueue {
+        ~CloseQueue() { queue.close(); }
+        ConcurrentQueue<DirEntry>& queue;
+    } closer{queue};
+    return walkDirectory(root, opts, [&queue](DirEntry&& entry) { queue.push(move(entry)); });
+}
+
+// All entries, sorted by path
+inline vector<DirEntry> walkDirectory(const string& root, const WalkOptions& opts = WalkOptions())
+{
+    vector<DirEntry> entries;
+    mutex entries_mutex;
+    walkDirectory(root, opts, [&](DirEntry&& entry) {
+        lock_guard<mutex> lock(entries_mutex);
+        entries.push_back(move(entry));
+    });
+    sort(entries.begin(), entries.end(), [](const DirEntry& left, const DirEntry& right) {
+        return left.path < right.path;
+    });
+    return entries;
+}
+_CLS_END
+
+#endif // CLS_DIR_WALK_HPP
@@ -25,26 +25,188 @@
 #ifndef CLS_DYN_BITSET_HPP
 #define CLS_DYN_BITSET_HPP
 
+#include <cstdint>
 #include <vector>
-#include <bitset>
+#include <string>
 #include <algorithm>
-#include <numeric>
+#include <iterator>
 #include <stdexcept>
 #include "byte_array.hpp"
+#include "allocator.hpp"
+#include "bit_ops.hpp"
+#include "endian.hpp"
+#include "hash.hpp"
 
 _CLS_BEGIN
+namespace detail {
+// Forward iterator over the set bits of a word array in string order. Words are
+// visited front to back in string order, back to front in index order.
+template<bool StringOrder>
+class SetBitIterator {
+public:
+    using iterator_category = forward_iterator_tag;
+    using value_type        = size_t;
+    using difference_type   = ptrdiff_t;
+    using pointer           = const size_t*;
+    using reference         = size_t;
+
+    SetBitIterator() : words(nullptr), num_words(0), bit_size(0), step(0), word(0) {}
+
+    SetBitIterator(const uint64_t* words, size_t num_words, size_t bit_size, bool at_end)
+        : words(words), num_words(num_words), bit_size(bit_size),
+          step(at_end ? num_words : 0), word(0) {
+        if (step < num_words) {
+            word = words[wordIndex()];
+            if (!word) nextWord();
+        }
+    }
+
+    size_t operator*() const {
+        if (StringOrder) return wordIndex() * 64 + clz(word);
+        return bit_size + ctz(word) - 64 * (wordIndex() + 1);
+    }
+
+    SetBitIterator& operator++() {
+        if (StringOrder) word &= ~(uint64_t(1) << (63 - clz(word)));
+        else             word &= word - 1;
+        if (!word) nextWord();
+        return *this;
+    }
+
+    SetBitIterator operator++(int) {
+        auto old = *this;
+        ++(*this);
+        return old;
+    }
+
+    bool operator==(const SetBitIterator& other) const {
+        return step == other.step && word == other.word;
+    }
+
+    bool operator!=(const SetBitIterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    size_t wordIndex() const {
+        return StringOrder ? step : num_words - 1 - step;
+    }
+
+    // Skip empty words, word stays 0 at the end
+    void nextWord() {
+        while (++step < num_words) {
+            word = words[wordIndex()];
+            if (word) return;
+        }
+    }
+
+    const uint64_t* words;
+    size_t num_words;
+    size_t bit_size;
+    size_t step;
+    uint64_t word;
+};
+
+// First set string position >= from in words holding bit_size bits, size_t(-1) if none
+inline size_t findFirstPos(const uint64_t* words, size_t bit_size, size_t from)
+{
+    if (from >= bit_size) return size_t(-1);
+    auto last = (bit_size + 63) / 64;
+    auto w    = from / 64;
+    auto word = words[w] & (~uint64_t(0) >> (from % 64));
+    while (!word) {
+        if (++w == last) return size_t(-1);
+        word = words[w];
+    }
+    return w * 64 + clz(word);
+}
+
+// Last set string position <= to, size_t(-1) if none
+inline size_t findLastPos(const uint64_t* words, size_t bit_size, size_t to)
+{
+    if (bit_size == 0) return size_t(-1);
+    to = min(to, bit_size - 1);
+    auto w    = to / 64;
+    auto word = words[w] & (~uint64_t(0) << (63 - to % 64));
+    while (!word) {
+        if (w-- == 0) return size_t(-1);
+        word = words[w];
+    }
+    return w * 64 + 63 - ctz(word);
+}
+
+template<typename Iterator>
+class IteratorRange {
+public:
+    using iterator       = Iterator;
+    using const_iterator = Iterator;
+
+    IteratorRange(Iterator first, Iterator last) : first(first), last(last) {}
+
+    Iterator begin() const { return first; }
+    Iterator end() const   { return last; }
+
+private:
+    Iterator first;
+    Iterator last;
+};
+
+// Size check of the binary operations, false only without exceptions
+inline bool checkSameSize(size_t left, size_t right)
+{
+#if CLS_HAS_EXCEPT
+    if (left != right) throw invalid_argument("bitset sizes differ");
+#else
+    ASSERT(left == right);
+#endif
+    return left == right;
+}
+} // End namespace detail
+
+// Bits are kept in 64-bit words in string order: the first character of to_string() is
+// the most significant bit of the first word, unused bits at the end of the last word
+// are always zero. DynBitset indexes from the right like std::bitset, BitField from
+// the left.
 class DynBitset {
 protected:
-    static const size_t BYTESIZE = 8;
-    using Byte = bitset<BYTESIZE>;
+    using Word = uint64_t;
+    static const size_t WORDSIZE = 64;
 
 public:
-    DynBitset() = default;
+    using Storage = vector<Word, AlignedAllocator<Word, 64>>;
+
+    class reference {
+    public:
+        reference(Word& word, Word mask) : word(&word), mask(mask) {}
+
+        operator bool() const { return (*word & mask) != 0; }
+        bool operator~() const { return (*word & mask) == 0; }
+
+        reference& operator=(bool val) {
+            if (val) *word |= mask;
+            else     *word &= ~mask;
+            return *this;
+        }
+
+        reference& operator=(const reference& other) {
+            return *this = static_cast<bool>(other);
+        }
+
+        reference& flip() {
+            *word ^= mask;
+            return *this;
+        }
+
+    private:
+        Word* word;
+        Word  mask;
+    };
+
+    DynBitset() : bit_size(0), offset(0) {}
     DynBitset(size_t n)
-        : bit_field((n + BYTESIZE - 1) / BYTESIZE),
+        : bit_field((n + WORDSIZE - 1) / WORDSIZE),
           bit_size(n),
-          offset(BYTESIZE*bit_field.size() - n),
-          last_size(n - BYTESIZE*(bit_field.size() - 1)) {}
+          offset(WORDSIZE*bit_field.size() - n) {}
     DynBitset(size_t n, const string& val) {
         fromString(n, val);
     }
@@ -53,65 +215,69 @@ public:
         fromByteArray(n, data);
     }
 
-    // Conversion from/to byte array and string
+    // Conversion from/to byte array and string, bytes are in string order
     void fromByteArray(size_t n, const ByteArray& data) {
-        bit_field.resize((n + BYTESIZE - 1) / BYTESIZE);
-        bit_size  = n;
-        offset    = BYTESIZE*bit_field.size() - n;
-        last_size = n - BYTESIZE*(bit_field.size() - 1);
-
-        for (auto idx = 0u; idx < bit_field.size(); ++idx) {
-            bit_field[idx] = static_cast<ullong>(data[idx]);
+        init(n);
+        auto num_bytes = min((n + 7) / 8, data.size());
+        for (size_t idx = 0; idx < num_bytes; ++idx) {
+            bit_field[idx / 8] |= Word(uchar(data[idx])) << (56 - 8 * (idx % 8));
         }
+        clearPadding();
     }
 
     void fromString(size_t n, const string& val) {
-        bit_field.resize((n + BYTESIZE - 1) / BYTESIZE);
-        bit_size  = n;
-        offset    = BYTESIZE*bit_field.size() - n;
-        last_size = n - BYTESIZE*(bit_field.size() - 1);
-
-        size_t idx = 0;
-        auto byte = bit_field.begin();
-        do {
-            *byte++ = Byte(val.substr(idx, BYTESIZE));
-        } while ((idx += BYTESIZE) < val.length());
-        bit_field.back() <<= BYTESIZE - last_size;
+        init(n);
+        auto len = min(n, val.length());
+        for (size_t pos = 0; pos < len; ++pos) {
+            if (val[pos] == '1') {
+                bit_field[pos / WORDSIZE] |= maskOf(pos);
+            } else if (val[pos] != '0') {
+#if CLS_HAS_EXCEPT
+                throw invalid_argument("DynBitset string contains invalid character");
+#endif
+            }
+        }
     }
 
     auto toByteArray() const -> ByteArray {
-        ByteArray data(bit_field.size());
-        for (auto i = 0u; i < bit_field.size(); ++i) {
-            data[i] = static_cast<char>(bit_field[i].to_ulong());
+        ByteArray data;
+        data.resize_uninitialized((bit_size + 7) / 8);
+        size_t idx = 0;
+        for (; idx + 8 <= data.size(); idx += 8) {
+            storeBE(data.data() + idx, bit_field[idx / 8]);
+        }
+        for (; idx < data.size(); ++idx) {
+            data[idx] = static_cast<char>(bit_field[idx / 8] >> (56 - 8 * (idx % 8)));
         }
         return data;
     }
 
     auto to_string() const -> string {
-        string str;
-        for (const auto& byte : bit_field) {
-            str += byte.to_string();
+        string str(bit_size, '0');
+        for (size_t idx = 0; idx < bit_field.size(); ++idx) {
+            auto word = bit_field[idx];
+            while (word) {
+                auto pos = idx * WORDSIZE + clz(word);
+                str[pos] = '1';
+                word &= ~maskOf(pos);
+            }
         }
-        return str.substr(0, bit_size);
+        return str;
     }
 
     // Bit access
-    auto operator[](size_t idx) -> Byte::reference {
-        idx += offset;
-        auto vec_idx = bit_field.size() - 1 - idx / BYTESIZE;
-        return bit_field[vec_idx][idx % BYTESIZE];
+    auto operator[](size_t idx) -> reference {
+        auto pos = bit_size - 1 - idx;
+        return reference(bit_field[pos / WORDSIZE], maskOf(pos));
     }
 
     bool operator[](size_t idx) const {
-        idx += offset;
-        auto vec_idx = bit_field.size() - 1 - idx / BYTESIZE;
-        return bit_field[vec_idx][idx % BYTESIZE];
+        auto pos = bit_size - 1 - idx;
+        return (bit_field[pos / WORDSIZE] & maskOf(pos)) != 0;
     }
 
     size_t count() const {
-        return accumulate(bit_field, size_t(0), [](size_t init, const Byte& byte) {
-            return init + byte.count();
-        });
+        return popcount(bit_field.data(), bit_field.size());
     }
 
     size_t size() const { return bit_size; }
@@ -124,8 +290,8 @@ public:
     }
 
     bool any() const {
-        return any_of(bit_field, [](const Byte& byte) {
-            return byte.any();
+        return any_of(bit_field.begin(), bit_field.end(), [](Word word) {
+            return word != 0;
         });
     }
 
@@ -134,43 +300,272 @@ public:
     }
 
     bool all() const {
-        bool all_set =  all_of(bit_field, [](const Byte& byte) {
-            return byte.all();
+        if (bit_field.empty()) return true;
+        bool all_set = all_of(bit_field.begin(), bit_field.end() - 1, [](Word word) {
+            return word == ~Word(0);
         });
-        return all_set && bit_field.back().count() == last_size;
+        return all_set && bit_field.back() == lastWordMask();
     }
 
     // Bit operation
     DynBitset& set() {
-        for_each(bit_field.begin(), bit_field.end() - 1, [](Byte& byte) {
-            byte.set();
-        });
-        bit_field.back() = Byte(string(last_size, '1'));
-        bit_field.back() <<= BYTESIZE - bit_field.back().count();
+        fill(bit_field.begin(), bit_field.end(), ~Word(0));
+        clearPadding();
+        return (*this);
+    }
+
+    DynBitset& set(size_t idx, bool val = true) {
+        (*this)[idx] = val;
         return (*this);
     }
 
     DynBitset& reset() {
-        for_each(bit_field, [](Byte& byte) {
-            byte.reset();
-        });
+        fill(bit_field.begin(), bit_field.end(), Word(0));
+        return (*this);
+    }
+
+    DynBitset& reset(size_t idx) {
+        return set(idx, false);
+    }
+
+    DynBitset& flip() {
+        for (auto& word : bit_field) word = ~word;
+        clearPadding();
+        return (*this);
+    }
+
+    DynBitset& flip(size_t idx) {
+        (*this)[idx].flip();
+        return (*this);
+    }
+
+    // Bitwise algebra, operands must have the same size
+    DynBitset& operator&=(const DynBitset& other) {
+        checkSize(other);
+        andWords(bit_field.data(), other.bit_field.data(), bit_field.size());
+        return (*this);
+    }
+
+    DynBitset& operator|=(const DynBitset& other) {
+        checkSize(other);
+        orWords(bit_field.data(), other.bit_field.data(), bit_field.size());
+        return (*this);
+    }
+
+    DynBitset& operator^=(const DynBitset& other) {
+        checkSize(other);
+        xorWords(bit_field.data(), other.bit_field.data(), bit_field.size());
+        return (*this);
+    }
+
+    // *this &= ~other
+    DynBitset& andNot(const DynBitset& other) {
+        checkSize(other);
+        andNotWords(bit_field.data(), other.bit_field.data(), bit_field.size());
+        return (*this);
+    }
+
+    DynBitset operator~() const {
+        return DynBitset(*this).flip();
+    }
+
+    // Shift towards higher indices, i.e. to the left of to_string()
+    DynBitset& operator<<=(size_t n) {
+        if (n >= bit_size) return reset();
+        auto word_shift = n / WORDSIZE;
+        auto bit_shift  = n % WORDSIZE;
+        auto num_words  = bit_field.size();
+        for (size_t idx = 0; idx + word_shift < num_words; ++idx) {
+            auto src = idx + word_shift;
+            auto val = bit_field[src] << bit_shift;
+            if (bit_shift && src + 1 < num_words) {
+                val |= bit_field[src + 1] >> (WORDSIZE - bit_shift);
+            }
+            bit_field[idx] = val;
+        }
+        fill(bit_field.end() - word_shift, bit_field.end(), Word(0));
+        return (*this);
+    }
+
+    // Shift towards lower indices, i.e. to the right of to_string()
+    DynBitset& operator>>=(size_t n) {
+        if (n >= bit_size) return reset();
+        auto word_shift = n / WORDSIZE;
+        auto bit_shift  = n % WORDSIZE;
+        for (size_t idx = bit_field.size(); idx-- > word_shift;) {
+            auto src = idx - word_shift;
+            auto val = bit_field[src] >> bit_shift;
+            if (bit_shift && src > 0) {
+                val |= bit_field[src - 1] << (WORDSIZE - bit_shift);
+            }
+            bit_field[idx] = val;
+        }
+        fill(bit_field.begin(), bit_field.begin() + word_shift, Word(0));
+        clearPadding();
+        return (*this);
+    }
+
+    DynBitset operator<<(size_t n) const { return DynBitset(*this) <<= n; }
+    DynBitset operator>>(size_t n) const { return DynBitset(*this) >>= n; }
+
+    // Growing and shrinking work at the end of to_string(), the BitField end: resize
+    // keeps the first n characters, push_back and append concatenate strings. Seen
+    // through DynBitset indices the existing bits move up, like shifting in at bit 0.
+    void resize(size_t n, bool val = false) {
+        auto old_size = bit_size;
+        bit_field.resize((n + WORDSIZE - 1) / WORDSIZE, val ? ~Word(0) : Word(0));
+        if (val && n > old_size && old_size % WORDSIZE) {
+            bit_field[old_size / WORDSIZE] |= ~Word(0) >> (old_size % WORDSIZE);
+        }
+        setSize(n);
+    }
+
+    // Amortized O(1)
+    void push_back(bool val) {
+        if (bit_size % WORDSIZE == 0) bit_field.push_back(0);
+        if (val) bit_field[bit_size / WORDSIZE] |= maskOf(bit_size);
+        ++bit_size;
+        offset = WORDSIZE*bit_field.size() - bit_size;
+    }
+
+    DynBitset& append(const DynBitset& other) {
+        if (&other == this) return append(DynBitset(other));
+        auto shift = bit_size % WORDSIZE;
+        auto old_words = bit_field.size();
+        if (shift == 0) {
+            bit_field.insert(bit_field.end(), other.bit_field.begin(), other.bit_field.end());
+        } else {
+            bit_field.reserve(old_words + other.bit_field.size());
+            for (auto word : other.bit_field) {
+                bit_field.back() |= word >> shift;
+                bit_field.push_back(word << (WORDSIZE - shift));
+            }
+            bit_field.resize((bit_size + other.bit_size + WORDSIZE - 1) / WORDSIZE);
+        }
+        setSize(bit_size + other.bit_size);
         return (*this);
     }
 
-//     void resize(size_t n) {
-//         bit_field.resize((n + BYTESIZE - 1) / BYTESIZE);
-//         bit_size = n;
-//         offset = BYTESIZE*bit_field.size() - n;
-//         last_size = n - BYTESIZE*(bit_field.size() - 1);
-//         bit_field.back() = Byte(bit_field.back().to_string().substr(0, last_size));
-//         bit_field.back() <<= BYTESIZE - last_size;
-//     }
+    // Capacity in bits
+    void reserve(size_t n)  { bit_field.reserve((n + WORDSIZE - 1) / WORDSIZE); }
+    size_t capacity() const { return bit_field.capacity() * WORDSIZE; }
+    void shrink_to_fit()    { bit_field.shrink_to_fit(); }
+    bool empty() const      { return bit_size == 0; }
+
+    void clear() {
+        bit_field.clear();
+        setSize(0);
+    }
+
+    // Set bit search by index, npos if there is none. Empty words are skipped.
+    static const size_t npos = size_t(-1);
+
+    size_t find_first() const {
+        return toIndex(findLastPos(npos));
+    }
+
+    // First set index after idx
+    size_t find_next(size_t idx) const {
+        if (bit_size == 0 || idx >= bit_size - 1) return npos;
+        return toIndex(findLastPos(bit_size - 2 - idx));
+    }
+
+    // Last set index before idx
+    size_t find_prev(size_t idx) const {
+        if (idx == 0) return npos;
+        return toIndex(findFirstPos(bit_size - min(idx, bit_size)));
+    }
+
+    size_t find_last() const {
+        return toIndex(findFirstPos(0));
+    }
+
+    // Calls func(idx) for each set index in ascending order
+    template<typename Func>
+    void for_each_set(Func func) const {
+        for (size_t w = bit_field.size(); w-- > 0;) {
+            auto word = bit_field[w];
+            auto base = bit_size - WORDSIZE * (w + 1);
+            while (word) {
+                func(base + ctz(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    // Range of the set indices in ascending order
+    using set_bit_iterator = detail::SetBitIterator<false>;
+
+    auto set_bits() const -> detail::IteratorRange<set_bit_iterator> {
+        return {set_bit_iterator(bit_field.data(), bit_field.size(), bit_size, false),
+                set_bit_iterator(bit_field.data(), bit_field.size(), bit_size, true)};
+    }
+
+    // Raw word storage in string order, the padding bits must stay zero
+    Word* data()             { return bit_field.data(); }
+    const Word* data() const { return bit_field.data(); }
+    size_t num_words() const { return bit_field.size(); }
+
+    friend bool operator==(const DynBitset& left, const DynBitset& right) {
+        return left.bit_size == right.bit_size && left.bit_field == right.bit_field;
+    }
+
+    // Same order as comparing the strings from to_string()
+    friend bool operator<(const DynBitset& left, const DynBitset& right) {
+        auto mis = mismatch(left.bit_field.begin(), left.bit_field.end(),
+                            right.bit_field.begin(), right.bit_field.end());
+        if (mis.first != left.bit_field.end() && mis.second != right.bit_field.end()) {
+            return *mis.first < *mis.second;
+        }
+        return left.bit_size < right.bit_size;
+    }
 
 protected:
-    vector<Byte> bit_field;
+    void checkSize(const DynBitset& other) const {
+        detail::checkSameSize(bit_size, other.bit_size);
+    }
+
+    void init(size_t n) {
+        bit_field.assign((n + WORDSIZE - 1) / WORDSIZE, Word(0));
+        bit_size = n;
+        offset   = WORDSIZE*bit_field.size() - n;
+    }
+
+    // Word count must already match n
+    void setSize(size_t n) {
+        bit_size = n;
+        offset   = WORDSIZE*bit_field.size() - n;
+        clearPadding();
+    }
+
+    // Mask of the bit at a string position within its word
+    static Word maskOf(size_t pos) {
+        return Word(1) << (WORDSIZE - 1 - pos % WORDSIZE);
+    }
+
+    size_t toIndex(size_t pos) const {
+        return pos == npos ? npos : bit_size - 1 - pos;
+    }
+
+    size_t findFirstPos(size_t from) const {
+        return detail::findFirstPos(bit_field.data(), bit_size, from);
+    }
+
+    size_t findLastPos(size_t to) const {
+        return detail::findLastPos(bit_field.data(), bit_size, to);
+    }
+
+    Word lastWordMask() const {
+        return ~Word(0) << offset;
+    }
+
+    void clearPadding() {
+        if (!bit_field.empty()) bit_field.back() &= lastWordMask();
+    }
+
+    Storage bit_field;
     size_t bit_size;
     size_t offset;
-    size_t last_size;
 };
 
 // This class access the bit from left to right
@@ -184,23 +579,43 @@ struct BitField : DynBitset {
     BitField(size_t n, const ByteArray& data) : DynBitset(n, data) {}
 #endif
 
-    auto operator[](size_t idx) -> Byte::reference {
-        auto vec_idx = idx / BYTESIZE;
-        return bit_field[vec_idx][BYTESIZE - 1 - idx % BYTESIZE];
+    auto operator[](size_t idx) -> reference {
+        return reference(bit_field[idx / WORDSIZE], maskOf(idx));
     }
 
     bool operator[](size_t idx) const {
-        auto vec_idx = idx / BYTESIZE;
-        return bit_field[vec_idx][BYTESIZE - 1 - idx % BYTESIZE];
+        return (bit_field[idx / WORDSIZE] & maskOf(idx)) != 0;
+    }
+
+    // Set bit search by position
+    size_t find_first() const { return findFirstPos(0); }
+    size_t find_last() const  { return findLastPos(npos); }
+
+    size_t find_next(size_t idx) const {
+        return idx == npos ? npos : findFirstPos(idx + 1);
+    }
+
+    size_t find_prev(size_t idx) const {
+        return idx == 0 ? npos : findLastPos(idx - 1);
+    }
+
+    template<typename Func>
+    void for_each_set(Func func) const {
+        for (size_t w = 0; w < bit_field.size(); ++w) {
+            auto word = bit_field[w];
+            while (word) {
+                auto bit = clz(word);
+                func(w * WORDSIZE + bit);
+                word &= ~maskOf(bit);
+            }
+        }
     }
 
-    void resize(size_t n) {
-        bit_field.resize((n + BYTESIZE - 1) / BYTESIZE);
-        bit_size  = n;
-        offset    = BYTESIZE*bit_field.size() - n;
-        last_size = n - BYTESIZE*(bit_field.size() - 1);
-        bit_field.back() = Byte(bit_field.back().to_string().substr(0, last_size));
-        bit_field.back() <<= BYTESIZE - last_size;
+    using set_bit_iterator = detail::SetBitIterator<true>;
+
+    auto set_bits() const -> detail::IteratorRange<set_bit_iterator> {
+        return {set_bit_iterator(bit_field.data(), bit_field.size(), bit_size, false),
+                set_bit_iterator(bit_field.data(), bit_field.size(), bit_size, true)};
     }
 };
 
@@ -210,15 +625,85 @@ inline ostream& operator<<(ostream& os, const DynBitset& data)
     return os;
 }
 
-inline bool operator==(const DynBitset& left, const DynBitset& right)
+inline DynBitset operator&(const DynBitset& left, const DynBitset& right)
+{
+    return DynBitset(left) &= right;
+}
+
+inline DynBitset operator|(const DynBitset& left, const DynBitset& right)
+{
+    return DynBitset(left) |= right;
+}
+
+inline DynBitset operator^(const DynBitset& left, const DynBitset& right)
+{
+    return DynBitset(left) ^= right;
+}
+
+// left & ~right
+inline DynBitset andNot(const DynBitset& left, const DynBitset& right)
+{
+    return DynBitset(left).andNot(right);
+}
+
+// Fused counts, same as count() of the combined bitset without building it
+inline size_t countAnd(const DynBitset& left, const DynBitset& right)
+{
+    if (!detail::checkSameSize(left.size(), right.size())) return 0;
+    return popcountAnd(left.data(), right.data(), left.num_words());
+}
+
+inline size_t countOr(const DynBitset& left, const DynBitset& right)
+{
+    if (!detail::checkSameSize(left.size(), right.size())) return 0;
+    return popcountOr(left.data(), right.data(), left.num_words());
+}
+
+inline size_t countXor(const DynBitset& left, const DynBitset& right)
+{
+    if (!detail::checkSameSize(left.size(), right.size())) return 0;
+    return popcountXor(left.data(), right.data(), left.num_words());
+}
+
+inline size_t countAndNot(const DynBitset& left, const DynBitset& right)
 {
-    return left.to_string() == right.to_string();
+    if (!detail::checkSameSize(left.size(), right.size())) return 0;
+    return popcountAndNot(left.data(), right.data(), left.num_words());
 }
 
 inline bool operator!=(const DynBitset& left, const DynBitset& right)
 {
     return !(left == right);
 }
+
+inline bool operator>(const DynBitset& left, const DynBitset& right)
+{
+    return right < left;
+}
+
+inline bool operator<=(const DynBitset& left, const DynBitset& right)
+{
+    return !(right < left);
+}
+
+inline bool operator>=(const DynBitset& left, const DynBitset& right)
+{
+    return !(left < right);
+}
 _CLS_END
 
-#endif // CLS_DYN_BITSET_HPP
\ No newline at end of file
+namespace std {
+template<>
+struct hash<cls::DynBitset> {
+    size_t operator()(const cls::DynBitset& bits) const {
+        cls::Hash64 hasher(bits.size());
+        hasher.update(bits.data(), bits.num_words() * sizeof(*bits.data()));
+        return static_cast<size_t>(hasher.digest());
+    }
+};
+
+template<>
+struct hash<cls::BitField> : hash<cls::DynBitset> {};
+} // End namespace std
+
+#endif // CLS_DYN_BITSET_HPP
@@ -0,0 +1,268 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_ENDIAN_HPP
+#define CLS_ENDIAN_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "byte_array.hpp"
+
+#if CLS_HAS_AVX2
+#  include <immintrin.h>
+#elif CLS_HAS_SSSE3
+#  include <tmmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#  include <stdlib.h>
+#endif
+
+_CLS_BEGIN
+enum class Endian {
+    Little,
+    Big,
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    Native = Big
+#else
+    Native = Little
+#endif
+};
+
+inline uint8_t byteswap(uint8_t val)
+{
+    return val;
+}
+
+inline uint16_t byteswap(uint16_t val)
+{
+#ifdef _MSC_VER
+    return _byteswap_ushort(val);
+#else
+    return __builtin_bswap16(val);
+#endif
+}
+
+inline uint32_t byteswap(uint32_t val)
+{
+#ifdef _MSC_VER
+    return _byteswap_ulong(val);
+#else
+    return __builtin_bswap32(val);
+#endif
+}
+
+inline uint64_t byteswap(uint64_t val)
+{
+#ifdef _MSC_VER
+    return _byteswap_uint64(val);
+#else
+    return __builtin_bswap64(val);
+#endif
+}
+
+namespace detail {
+template<size_t N> struct UIntOfSize {};
+template<> struct UIntOfSize<1> { using type = uint8_t; };
+template<> struct UIntOfSize<2> { using type = uint16_t; };
+template<> struct UIntOfSize<4> { using type = uint32_t; };
+template<> struct UIntOfSize<8> { using type = uint64_t; };
+
+template<typename T>
+using uint_of_t = typename UIntOfSize<sizeof(T)>::type;
+
+template<typename T>
+struct is_endian_type : integral_constant<bool,
+    (is_integral<T>::value || is_floating_point<T>::value || is_enum<T>::value) &&
+    (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)>
+{};
+} // End namespace detail
+
+// Load/store a value in the given byte order from unaligned memory. memcpy and
+// byteswap are recognized by the compiler, each call becomes a single (movbe) load
+// or store on x86.
+template<Endian Order, typename T>
+inline T load(const void* ptr)
+{
+    static_assert(detail::is_endian_type<T>::value, "Unsupported type for endian load");
+    detail::uint_of_t<T> bits;
+    memcpy(&bits, ptr, sizeof(bits));
+    if (Order != Endian::Native) bits = byteswap(bits);
+    T val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+template<Endian Order, typename T>
+inline void store(void* ptr, T val)
+{
+    static_assert(detail::is_endian_type<T>::value, "Unsupported type for endian store");
+    detail::uint_of_t<T> bits;
+    memcpy(&bits, &val, sizeof(bits));
+    if (Order != Endian::Native) bits = byteswap(bits);
+    memcpy(ptr, &bits, sizeof(bits));
+}
+
+template<typename T>
+inline T loadLE(const void* ptr) { return load<Endian::Little, T>(ptr); }
+
+template<typename T>
+inline T loadBE(const void* ptr) { return load<Endian::Big, T>(ptr); }
+
+template<typename T>
+inline void storeLE(void* ptr, T val) { store<Endian::Little>(ptr, val); }
+
+template<typename T>
+inline void storeBE(void* ptr, T val) { store<Endian::Big>(ptr, val); }
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Bulk byte swap
+namespace detail {
+template<typename UInt>
+inline void byteswapScalar(const char* src, char* dst, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        UInt val;
+        memcpy(&val, src + i * sizeof(UInt), sizeof(UInt));
+        val = byteswap(val);
+        memcpy(dst + i * sizeof(UInt), &val, sizeof(UInt));
+    }
+}
+
+#if CLS_HAS_SSSE3
+// pshufb control that reverses the bytes of every lane of the given size
+inline __m128i byteswapMask(size_t lane_size)
+{
+    alignas(16) char mask[16];
+    for (size_t i = 0; i < 16; ++i) {
+        auto lane_start = i / lane_size * lane_size;
+        mask[i] = static_cast<char>(lane_start + lane_size - 1 - (i - lane_start));
+    }
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+}
+#endif
+} // End namespace detail
+
+// Reverse the bytes of count lanes of lane_size (1, 2, 4 or 8) bytes each. src and dst
+// may be the same buffer but must not otherwise overlap.
+inline void byteswapArray(const void* src, void* dst, size_t count, size_t lane_size)
+{
+    ASSERT(lane_size == 1 || lane_size == 2 || lane_size == 4 || lane_size == 8);
+
+    auto in  = static_cast<const char*>(src);
+    auto out = static_cast<char*>(dst);
+    if (lane_size == 1) {
+        if (in != out) memcpy(out, in, count);
+        return;
+    }
+
+    size_t bytes = count * lane_size;
+    size_t pos   = 0;
+#if CLS_HAS_SSSE3
+    auto mask = detail::byteswapMask(lane_size);
+#  if CLS_HAS_AVX2
+    auto mask256 = _mm256_broadcastsi128_si256(mask);
+    for (; pos + 64 <= bytes; pos += 64) {
+        auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + pos));
+        auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + pos + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + pos), _mm256_shuffle_epi8(v0, mask256));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + pos + 32), _mm256_shuffle_epi8(v1, mask256));
+    }
+#  endif
+    for (; pos + 16 <= bytes; pos += 16) {
+        auto val = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + pos), _mm_shuffle_epi8(val, mask));
+    }
+#endif
+
+    auto rest = (bytes - pos) / lane_size;
+    switch (lane_size) {
+    case 2:  detail::byteswapScalar<uint16_t>(in + pos, out + pos, rest); break;
+    case 4:  detail::byteswapScalar<uint32_t>(in + pos, out + pos, rest); break;
+    default: detail::byteswapScalar<uint64_t>(in + pos, out + pos, rest); break;
+    }
+}
+
+// Swap every lane in place, trailing bytes that don't fill a whole lane are untouched
+template<typename Alloc>
+inline void byteswapInPlace(BasicByteArray<Alloc>& data, size_t lane_size)
+{
+    byteswapArray(data.data(), data.data(), data.size() / lane_size, lane_size);
+}
+
+// Swapped copy, trailing bytes that don't fill a whole lane are copied as they are
+inline ByteArray byteswapCopy(ByteView data, size_t lane_size)
+{
+    ByteArray result;
+    result.resize_uninitialized(data.size());
+    auto count = data.size() / lane_size;
+    byteswapArray(data.data(), result.data(), count, lane_size);
+    copy(data.begin() + count * lane_size, data.end(), result.begin() + count * lane_size);
+    return result;
+}
+
+// Decode an array of T stored in the given byte order, extra trailing bytes are ignored
+template<Endian Order, typename T>
+inline vector<T> loadArray(ByteView data)
+{
+    static_assert(detail::is_endian_type<T>::value, "Unsupported type for endian load");
+    vector<T> result(data.size() / sizeof(T));
+    if (Order == Endian::Native || sizeof(T) == 1) {
+        if (!result.empty()) memcpy(result.data(), data.data(), result.size() * sizeof(T));
+    } else {
+        byteswapArray(data.data(), result.data(), result.size(), sizeof(T));
+    }
+    return result;
+}
+
+template<Endian Order, typename T>
+inline ByteArray storeArray(const T* data, size_t count)
+{
+    static_assert(detail::is_endian_type<T>::value, "Unsupported type for endian store");
+    ByteArray result;
+    result.resize_uninitialized(count * sizeof(T));
+    if (Order == Endian::Native || sizeof(T) == 1) {
+        if (count) memcpy(result.data(), data, count * sizeof(T));
+    } else {
+        byteswapArray(data, result.data(), count, sizeof(T));
+    }
+    return result;
+}
+
+template<typename T>
+inline vector<T> loadArrayLE(ByteView data) { return loadArray<Endian::Little, T>(data); }
+
+template<typename T>
+inline vector<T> loadArrayBE(ByteView data) { return loadArray<Endian::Big, T>(data); }
+
+template<typename T>
+inline ByteArray storeArrayLE(const vector<T>& data) { return storeArray<Endian::Little>(data.data(), data.size()); }
+
+template<typename T>
+inline ByteArray storeArrayBE(const vector<T>& data) { return storeArray<Endian::Big>(data.data(), data.size()); }
+_CLS_END
+
+#endif // CLS_ENDIAN_HPP
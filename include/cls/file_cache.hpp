@@ -0,0 +1,277 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_FILE_CACHE_HPP
+#define CLS_FILE_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#include "file_sys.hpp"
+#include "byte_array.hpp"
+
+#if defined __linux__
+#  include <sys/inotify.h>
+#  define CLS_HAS_INOTIFY 1
+#else
+#  define CLS_HAS_INOTIFY 0
+#endif
+
+_CLS_BEGIN
+struct CacheOptions {
+    size_t capacity    = size_t(64) << 20;      // Bytes of file content kept
+    size_t max_entries = 0;                     // 0 for no limit
+    // Entries checked less than this long ago are served without a stat call
+    chrono::milliseconds revalidate_after = chrono::milliseconds(0);
+    // Invalidate entries from inotify events instead of calling stat on hits, Linux only
+    bool use_inotify = false;
+};
+
+struct CacheStats {
+    uint64_t hits          = 0;
+    uint64_t misses        = 0;
+    uint64_t evictions     = 0;
+    uint64_t invalidations = 0;    // Entries dropped because the file changed
+    size_t   entries       = 0;
+    size_t   bytes         = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Thread-safe LRU cache of whole file contents, for small files that are read over and
+// over. get() returns a shared immutable buffer that stays valid after eviction. A hit
+// is validated against the size and mtime of the cached read with one stat call, or
+// with none while revalidate_after hasn't passed or inotify reported no change. Files
+// larger than the capacity are read but not kept. Files are read outside the lock, so
+// concurrent misses on the same file may each read it.
+class FileCache {
+public:
+    using Buffer = shared_ptr<const ByteArray>;
+
+    explicit FileCache(const CacheOptions& options = CacheOptions()) : opts(options) {
+#if CLS_HAS_INOTIFY
+        if (opts.use_inotify) notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+
+    FileCache(const FileCache&) = delete;
+    FileCache& operator=(const FileCache&) = delete;
+
+    ~FileCache() {
+#if CLS_HAS_INOTIFY
+        if (notify_fd >= 0) ::close(notify_fd);
+#endif
+    }
+
+    bool usesInotify() const { return notify_fd >= 0; }
+
+    Buffer get(const string& file_name) {
+        auto now = chrono::steady_clock::now();
+        {
+            unique_lock<mutex> lock(mtx);
+            drainEvents();
+            auto iter = table.find(file_name);
+            if (iter != table.end()) {
+                auto& entry = *iter->second;
+                if (entry.watch >= 0 || now - entry.checked < opts.revalidate_after) {
+                    return hit(iter->second);
+                }
+                auto cached = entry.info;
+                lock.unlock();
+
+                FileInfo info;
+                bool found = fileInfo(file_name, info);
+                lock.lock();
+                iter = table.find(file_name);
+                if (found && iter != table.end() && iter->second->info == info && info == cached) {
+                    iter->second->checked = now;
+                    return hit(iter->second);
+                }
+                if (iter != table.end()) {
+                    erase(iter->second);
+                    ++counters.invalidations;
+                }
+            }
+            ++counters.misses;
+        }
+
+        // Stat before reading, a change during the read then shows up on the next check
+        FileInfo info;
+        if (!fileInfo(file_name, info) || !info.regular) {
+#if CLS_HAS_EXCEPT
+            throw FileExcept("Could not open file " + file_name);
+#else
+            cerr << "Fail to open the file" << endl;
+            return nullptr;
+#endif
+        }
+        auto buffer = make_shared<const ByteArray>(readBinaryFile(file_name));
+        if (buffer->size() > opts.capacity) return buffer;
+
+        lock_guard<mutex> lock(mtx);
+        auto iter = table.find(file_name);
+        if (iter != table.end()) erase(iter->second);
+        // A write between the read and the new watch raises no event, stat again to catch it
+        int watch = addWatch(file_name);
+        FileInfo watched;
+        if (watch >= 0 && (!fileInfo(file_name, watched) || watched != info)) {
+            removeWatch(watch, file_name);
+            return buffer;
+        }
+        lru.push_front(Entry{file_name, buffer, info, now, watch});
+        table[file_name] = lru.begin();
+        bytes += buffer->size();
+        while (bytes > opts.capacity || (opts.max_entries && lru.size() > opts.max_entries)) {
+            erase(prev(lru.end()));
+            ++counters.evictions;
+        }
+        return buffer;
+    }
+
+    void invalidate(const string& file_name) {
+        lock_guard<mutex> lock(mtx);
+        auto iter = table.find(file_name);
+        if (iter != table.end()) erase(iter->second);
+    }
+
+    void clear() {
+        lock_guard<mutex> lock(mtx);
+        while (!lru.empty()) erase(lru.begin());
+    }
+
+    CacheStats stats() const {
+        lock_guard<mutex> lock(mtx);
+        auto result    = counters;
+        result.entries = lru.size();
+        result.bytes   = bytes;
+        return result;
+    }
+
+private:
+    struct Entry {
+        string file_name;
+        Buffer data;
+        FileInfo info;
+        chrono::steady_clock::time_point checked;
+        int watch;
+    };
+    using EntryIter = list<Entry>::iterator;
+
+    Buffer hit(EntryIter entry) {
+        lru.splice(lru.begin(), lru, entry);
+        ++counters.hits;
+        return entry->data;
+    }
+
+    void erase(EntryIter entry) {
+        removeWatch(entry->watch, entry->file_name);
+        bytes -= entry->data->size();
+        table.erase(entry->file_name);
+        lru.erase(entry);
+    }
+
+    int addWatch(const string& file_name) {
+#if CLS_HAS_INOTIFY
+        if (notify_fd < 0) return -1;
+        int watch = inotify_add_watch(notify_fd, file_name.c_str(),
+                                      IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF |
+                                      IN_DELETE_SELF);
+        if (watch >= 0) watches[watch].push_back(file_name);
+        return watch;
+#else
+        (void)file_name;
+        return -1;
+#endif
+    }
+
+    void removeWatch(int watch, const string& file_name) {
+#if CLS_HAS_INOTIFY
+        auto iter = watches.find(watch);
+        if (iter == watches.end()) return;
+        auto& names = iter->second;
+        names.erase(remove(names.begin(), names.end(), file_name), names.end());
+        if (names.empty()) {
+            inotify_rm_watch(notify_fd, watch);
+            watches.erase(iter);
+        }
+#else
+        (void)watch;
+        (void)file_name;
+#endif
+    }
+
+    // Drop the entries of files reported as changed, or all watched entries if the event
+    // queue overflowed. One read() when nothing happened
+    void drainEvents() {
+#if CLS_HAS_INOTIFY
+        if (notify_fd < 0) return;
+        alignas(inotify_event) char events[4096];
+        ssize_t len;
+        while ((len = ::read(notify_fd, events, sizeof(events))) > 0) {
+            for (ssize_t pos = 0; pos < len;) {
+                auto event = reinterpret_cast<const inotify_event*>(events + pos);
+                pos += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {     // Events were lost, trust no watch
+                    for (auto entry = lru.begin(); entry != lru.end();) {
+                        auto current = entry++;
+                        if (current->watch < 0) continue;
+                        erase(current);
+                        ++counters.invalidations;
+                    }
+                    continue;
+                }
+                auto iter = watches.find(event->wd);
+                if (iter == watches.end()) continue;
+                auto names = move(iter->second);
+                watches.erase(iter);
+                if (!(event->mask & IN_IGNORED)) inotify_rm_watch(notify_fd, event->wd);
+                for (auto& name : names) {
+                    auto found = table.find(name);
+                    if (found == table.end()) continue;
+                    found->second->watch = -1;
+                    erase(found->second);
+                    ++counters.invalidations;
+                }
+            }
+        }
+#endif
+    }
+
+    CacheOptions opts;
+    mutable mutex mtx;
+    list<Entry> lru;
+    unordered_map<string, EntryIter> table;
+    unordered_map<int, vector<string>> watches;
+    size_t bytes = 0;
+    CacheStats counters;
+    int notify_fd = -1;
+};
+_CLS_END
+
+#endif // CLS_FILE_CACHE_HPP
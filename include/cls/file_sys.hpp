@@ -33,6 +33,10 @@
 #include <iterator>
 #include <stdexcept>
 #include <limits>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
 
 #if defined _WIN32 && defined _MSC_VER && _MSC_VER >= 1800
 #  include <filesystem>
@@ -40,7 +44,27 @@
 #  include <dirent.h>
 #endif
 
+#ifdef _WIN32
+#  include <windows.h>
+#  include <io.h>
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/uio.h>
+#endif
+
 #include "cls_defs.h"
+#include "byte_array.hpp"
+#include "bit_ops.hpp"
+#include "thread_pool.hpp"
+
+#if CLS_HAS_AVX2
+#  include <immintrin.h>
+#endif
 
 _CLS_BEGIN
 typedef istreambuf_iterator<char> ifsbuf_iter;
@@ -51,38 +75,732 @@ public:
     FileExcept(const string& err_msg) :runtime_error(err_msg) {};
 };
 
+// Size and modification time of a file, enough to tell whether it changed since
+struct FileInfo {
+    uint64_t size     = 0;
+    int64_t  mtime_ns = 0;  // Nanoseconds since the epoch of the platform clock
+    bool     regular  = false;
+
+    bool operator==(const FileInfo& other) const {
+        return size == other.size && mtime_ns == other.mtime_ns && regular == other.regular;
+    }
+    bool operator!=(const FileInfo& other) const { return !(*this == other); }
+};
+
+// False if the file doesn't exist or can't be accessed
+inline bool fileInfo(const string& file_name, FileInfo& info)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!GetFileAttributesExA(file_name.c_str(), GetFileExInfoStandard, &attr)) return false;
+    info.size     = (uint64_t(attr.nFileSizeHigh) << 32) | attr.nFileSizeLow;
+    info.mtime_ns = ((int64_t(attr.ftLastWriteTime.dwHighDateTime) << 32) |
+                     attr.ftLastWriteTime.dwLowDateTime) * 100;
+    info.regular  = (attr.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+#else
+    struct stat st;
+    if (::stat(file_name.c_str(), &st) != 0) return false;
+    info.size = static_cast<uint64_t>(st.st_size);
+#  ifdef __APPLE__
+    info.mtime_ns = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#  else
+    info.mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#  endif
+    info.regular = S_ISREG(st.st_mode);
+#endif
+    return true;
+}
+
+namespace detail {
+// Calls func(idx) for every idx in [0, n) with data[idx] == byte, in order. The AVX2 loop
+// compares 32 bytes at a time and walks the match mask, otherwise memchr does the scan.
+template<typename Func>
+inline void forEachByte(const char* data, size_t n, char byte, Func func)
+{
+    size_t idx = 0;
+#if CLS_HAS_AVX2
+    auto pattern = _mm256_set1_epi8(byte);
+    for (auto vec_end = n & ~size_t(31); idx < vec_end; idx += 32) {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx));
+        auto mask  = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern)));
+        while (mask) {
+            func(idx + ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    while (idx < n) {
+        auto found = static_cast<const char*>(memchr(data + idx, byte, n - idx));
+        if (!found) break;
+        idx = found - data;
+        func(idx++);
+    }
+}
+
+// Number of bytes equal to byte in [data, data + n). The matches are summed in byte
+// counters that are widened every 255 blocks, AVX2 compares 32 bytes at a time,
+// otherwise 8 bytes are tested with the exact zero byte test of x ^ pattern.
+inline size_t countByte(const char* data, size_t n, char byte)
+{
+    size_t count = 0;
+    size_t idx   = 0;
+#if CLS_HAS_AVX2
+    auto pattern = _mm256_set1_epi8(byte);
+    auto zero    = _mm256_setzero_si256();
+    auto sums    = zero;
+    while (n - idx >= 32) {
+        auto blocks = min((n - idx) / 32, size_t(255));
+        auto counts = zero;
+        for (size_t i = 0; i < blocks; ++i, idx += 32) {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + idx));
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(chunk, pattern));
+        }
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(counts, zero));
+    }
+    count = size_t(_mm256_extract_epi64(sums, 0)) + size_t(_mm256_extract_epi64(sums, 1)) +
+            size_t(_mm256_extract_epi64(sums, 2)) + size_t(_mm256_extract_epi64(sums, 3));
+#else
+    const uint64_t low7    = 0x7F7F7F7F7F7F7F7FULL;
+    const uint64_t pattern = 0x0101010101010101ULL * uchar(byte);
+    while (n - idx >= 8) {
+        auto blocks   = min((n - idx) / 8, size_t(255));
+        uint64_t sums = 0;
+        for (size_t i = 0; i < blocks; ++i, idx += 8) {
+            uint64_t word;
+            memcpy(&word, data + idx, 8);
+            word ^= pattern;
+            sums += (~(((word & low7) + low7) | word) & ~low7) >> 7;
+        }
+        count += ((sums & 0x00FF00FF00FF00FFULL) + ((sums >> 8) & 0x00FF00FF00FF00FFULL)) *
+                 0x0001000100010001ULL >> 48;
+    }
+#endif
+    for (; idx < n; ++idx) count += data[idx] == byte;
+    return count;
+}
+
+#ifndef _WIN32
+// Read a whole file with plain read() calls, resize(n) must grow the destination to n
+// bytes, keep its content and return its data. Regular files are sized by fstat and
+// read in one go, files without a size (pipes, proc files) double the buffer as needed.
+template<typename Resize>
+inline bool readWholeFile(const string& file_name, Resize resize)
+{
+    int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat info;
+    size_t size = 0;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) size = static_cast<size_t>(info.st_size);
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    bool sized = size != 0;
+    if (!sized) size = 4096;
+    size_t fill = 0;
+    auto buffer = resize(size);
+    while (true) {
+        if (fill == size) {     // Only without a known size
+            size  *= 2;
+            buffer = resize(size);
+        }
+        // Large reads are split by the kernel anyway (at ~2 GB on Linux)
+        auto bytes = ::read(fd, buffer + fill, min(size - fill, size_t(1) << 30));
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0) {
+            ::close(fd);
+            return false;
+        }
+        fill += static_cast<size_t>(bytes);
+        if (bytes == 0 || (sized && fill == size)) break;
+    }
+    ::close(fd);
+    resize(fill);
+    return true;
+}
+#endif
+} // End namespace detail
+
 
 inline string readFile(const string& file_name)
 {
+#ifndef _WIN32
+    string data;
+    if (detail::readWholeFile(file_name, [&data](size_t n) {
+            data.resize(n);
+            return &data[0];
+        })) {
+        return data;
+    }
+#else
     ifstream ifs(file_name);
-    if (!ifs.is_open()) {
+    if (ifs.is_open()) return string(ifsbuf_iter(ifs), ifsbuf_iter());
+#endif
+
 #if CLS_HAS_EXCEPT
-        throw FileExcept("Could not open file " + file_name);
+    throw FileExcept("Could not open file " + file_name);
 #else
-        cerr << "Fail to open the file" << endl;
-        return string("");
+    cerr << "Fail to open the file" << endl;
+    return string("");
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Memory mapping of a whole file, pages are loaded on first access. Read-write mappings
+// are shared with the file, flush() writes dirty pages back synchronously (unmapping
+// writes them back eventually anyway). view() reads the file without copying it.
+class MappedFile {
+public:
+    enum class Access { ReadOnly, ReadWrite };
+
+    // Access pattern hints for the kernel: Sequential reads ahead aggressively and drops
+    // pages behind, WillNeed starts reading the pages in now, HugePage asks for
+    // transparent huge pages where the file system supports them.
+    enum class Advice { Normal, Sequential, Random, WillNeed, HugePage };
+
+    MappedFile() = default;
+
+    explicit MappedFile(const string& file_name, Access mode = Access::ReadOnly) {
+        open(file_name, mode, false, 0);
+    }
+
+    // Create the file or truncate it to size bytes and map it read-write. New space is
+    // zero, most file systems don't allocate it until it is written.
+    static MappedFile create(const string& file_name, size_t size) {
+        MappedFile file;
+        file.open(file_name, Access::ReadWrite, true, size);
+        return file;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) { swap(other); }
+
+    MappedFile& operator=(MappedFile&& other) {
+        if (this != &other) {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~MappedFile() { close(); }
+
+    bool is_open() const  { return opened; }
+    bool writable() const { return access == Access::ReadWrite; }
+
+    const char* data() const { return static_cast<const char*>(addr); }
+    char* data()             { return static_cast<char*>(addr); }
+    size_t size() const      { return len; }
+    ByteView view() const    { return ByteView(data(), len); }
+
+    // Hint applies to the bytes [offset, offset + count), false if it is not supported
+    bool advise(Advice advice, size_t offset = 0, size_t count = size_t(-1)) const {
+        if (!addr || offset >= len) return false;
+        count = min(count, len - offset);
+#ifdef _WIN32
+        if (advice != Advice::WillNeed) return false;
+#  if defined _WIN32_WINNT && _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range = {data() + offset, count};
+        return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != 0;
+#  else
+        return false;
+#  endif
+#else
+        // madvise() needs a page aligned start
+        auto page  = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        auto start = offset / page * page;
+        auto ptr   = static_cast<char*>(addr) + start;
+        count += offset - start;
+        switch (advice) {
+        case Advice::Normal:     return posix_madvise(ptr, count, POSIX_MADV_NORMAL) == 0;
+        case Advice::Sequential: return posix_madvise(ptr, count, POSIX_MADV_SEQUENTIAL) == 0;
+        case Advice::Random:     return posix_madvise(ptr, count, POSIX_MADV_RANDOM) == 0;
+        case Advice::WillNeed:   return posix_madvise(ptr, count, POSIX_MADV_WILLNEED) == 0;
+        case Advice::HugePage:
+#  ifdef MADV_HUGEPAGE
+            return madvise(ptr, count, MADV_HUGEPAGE) == 0;
+#  else
+            return false;
+#  endif
+        }
+        return false;
 #endif
     }
 
-    return string(ifsbuf_iter(ifs), ifsbuf_iter());
-}
+    void flush() {
+        if (!addr || !writable()) return;
+#ifdef _WIN32
+        FlushViewOfFile(addr, 0);
+        FlushFileBuffers(file);
+#else
+        msync(addr, len, MS_SYNC);
+#endif
+    }
+
+    void close() {
+        if (addr) {
+#ifdef _WIN32
+            UnmapViewOfFile(addr);
+#else
+            munmap(addr, len);
+#endif
+        }
+#ifdef _WIN32
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file    = INVALID_HANDLE_VALUE;
+#endif
+        addr   = nullptr;
+        len    = 0;
+        opened = false;
+    }
 
-inline vector<char> readBinaryFile(const string& file_name)
+    void swap(MappedFile& other) {
+        std::swap(addr, other.addr);
+        std::swap(len, other.len);
+        std::swap(access, other.access);
+        std::swap(opened, other.opened);
+#ifdef _WIN32
+        std::swap(file, other.file);
+        std::swap(mapping, other.mapping);
+#endif
+    }
+
+private:
+    bool open(const string& file_name, Access mode, bool truncate, size_t new_size) {
+        access   = mode;
+        bool rw  = mode == Access::ReadWrite;
+#ifdef _WIN32
+        file = CreateFileA(file_name.c_str(), rw ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           truncate ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return fail("Could not open file " + file_name);
+        LARGE_INTEGER file_size;
+        if (truncate) {
+            file_size.QuadPart = static_cast<LONGLONG>(new_size);
+            if (!SetFilePointerEx(file, file_size, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+                return fail("Could not resize file " + file_name);
+            }
+        } else if (!GetFileSizeEx(file, &file_size)) {
+            return fail("Could not stat file " + file_name);
+        }
+        len = static_cast<size_t>(file_size.QuadPart);
+        if (len) {
+            mapping = CreateFileMappingA(file, nullptr, rw ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) addr = MapViewOfFile(mapping, rw ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+            if (!addr) return fail("Could not map file " + file_name);
+        }
+#else
+        int flags = rw ? O_RDWR : O_RDONLY;
+        if (truncate) flags |= O_CREAT | O_TRUNC;
+        int fd = ::open(file_name.c_str(), flags | O_CLOEXEC, 0644);
+        if (fd < 0) return fail("Could not open file " + file_name);
+        struct stat info;
+        bool sized = truncate ? ftruncate(fd, static_cast<off_t>(new_size)) == 0
+                              : fstat(fd, &info) == 0;
+        if (!sized) {
+            ::close(fd);
+            return fail("Could not size file " + file_name);
+        }
+        len = truncate ? new_size : static_cast<size_t>(info.st_size);
+        if (len) {
+            auto ptr = mmap(nullptr, len, rw ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+            if (ptr != MAP_FAILED) addr = ptr;
+        }
+        ::close(fd);
+        if (len && !addr) return fail("Could not map file " + file_name);
+#endif
+        opened = true;
+        return true;
+    }
+
+    bool fail(const string& err_msg) {
+        close();
+#if CLS_HAS_EXCEPT
+        throw FileExcept(err_msg);
+#else
+        cerr << err_msg << endl;
+        return false;
+#endif
+    }
+
+    void*  addr   = nullptr;
+    size_t len    = 0;
+    Access access = Access::ReadOnly;
+    bool   opened = false;
+#ifdef _WIN32
+    HANDLE file    = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+// The buffer is sized up front and filled by a single read without being cleared
+// first, pick the allocator to get e.g. page aligned or huge page backed buffers. Use
+// MappedFile instead to avoid the copy altogether.
+template<typename Alloc = allocator<char>>
+inline BasicByteArray<Alloc> readBinaryFile(const string& file_name)
 {
+#ifndef _WIN32
+    BasicByteArray<Alloc> data;
+    if (detail::readWholeFile(file_name, [&data](size_t n) {
+            data.resize_uninitialized(n);
+            return data.data();
+        })) {
+        return data;
+    }
+#  if CLS_HAS_EXCEPT
+    throw FileExcept("Could not open file " + file_name);
+#  else
+    cerr << "Fail to open the file" << endl;
+    return BasicByteArray<Alloc>();
+#  endif
+#else
     ifstream ifs(file_name, ios::binary);
     if (!ifs) {
 #if CLS_HAS_EXCEPT
         throw FileExcept("Could not open file " + file_name);
 #else
         cerr << "Fail to open the file" << endl;
-        return vector<char>();
+        return BasicByteArray<Alloc>();
+#endif
+    }
+
+    BasicByteArray<Alloc> data;
+    auto size = ifs.seekg(0, ios::end).tellg();
+    ifs.clear();
+    ifs.seekg(0, ios::beg);
+    if (size <= 0) {    // Size unknown, e.g. pipes and proc files
+        data.assign(ifsbuf_iter(ifs), ifsbuf_iter());
+        return data;
+    }
+
+    data.resize_uninitialized(static_cast<size_t>(size));
+    ifs.read(data.data(), size);
+    data.resize(static_cast<size_t>(ifs.gcount()));
+    return data;
+#endif
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// When written data is forced to the device: never (left to the OS), once on close(),
+// or additionally each time sync_bytes more bytes have been written
+enum class SyncPolicy { None, OnClose, EveryBytes };
+
+struct WriteOptions {
+    bool       atomic      = true;      // Write a temporary file and rename it over the target on close
+    SyncPolicy sync        = SyncPolicy::OnClose;
+    size_t     sync_bytes  = size_t(64) << 20;
+    size_t     buffer_size = size_t(1) << 20;
+    uint64_t   preallocate = 0;         // Expected size, reserved up front where supported
+};
+
+namespace detail {
+inline bool writeAll(int fd, const char* data, size_t n)
+{
+    while (n) {
+#ifdef _WIN32
+        auto bytes = _write(fd, data, static_cast<unsigned>(min<size_t>(n, size_t(1) << 30)));
+#else
+        auto bytes = ::write(fd, data, min<size_t>(n, size_t(1) << 30));
+        if (bytes < 0 && errno == EINTR) continue;
+#endif
+        if (bytes <= 0) return false;
+        data += bytes;
+        n    -= static_cast<size_t>(bytes);
+    }
+    return true;
+}
+
+// Write a list of buffers, with writev() in groups where available
+inline bool writeAll(int fd, const ByteView* views, size_t n)
+{
+#ifdef _WIN32
+    for (size_t i = 0; i < n; ++i) {
+        if (!writeAll(fd, views[i].data(), views[i].size())) return false;
+    }
+    return true;
+#else
+    const size_t max_iov = 1024;
+    iovec iov[max_iov];
+    while (n) {
+        size_t count = 0;
+        for (; count < n && count < max_iov; ++count) {
+            iov[count].iov_base = const_cast<char*>(views[count].data());
+            iov[count].iov_len  = views[count].size();
+        }
+        auto bytes = writev(fd, iov, static_cast<int>(count));
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0) return false;
+        // Skip what was written, finish a partially written buffer on its own
+        auto done = static_cast<size_t>(bytes);
+        while (n && done >= views->size()) {
+            done -= views->size();
+            ++views;
+            --n;
+        }
+        if (n && done) {
+            if (!writeAll(fd, views->data() + done, views->size() - done)) return false;
+            ++views;
+            --n;
+        }
+    }
+    return true;
+#endif
+}
+
+inline bool syncFile(int fd)
+{
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#elif defined __linux__
+    return fdatasync(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+} // End namespace detail
+
+// Buffered file writer. Data is collected in an aligned buffer and written in large
+// blocks, writes bigger than the buffer and write(chain) go to the file directly. In
+// atomic mode the data goes to a temporary file in the same directory which replaces
+// the target on close(), so readers see either the old or the complete new file.
+// Destroying an atomic writer without close() discards the temporary file.
+class FileWriter {
+public:
+    explicit FileWriter(const string& file_name, const WriteOptions& options = WriteOptions())
+        : target(file_name), opts(options) {
+        if (opts.atomic) {
+            // Exclusive create, an existing file or symlink of that name is never reused
+            static atomic<unsigned> counter(0);
+#ifdef _WIN32
+            auto pid = GetCurrentProcessId();
+#else
+            auto pid = getpid();
+#endif
+            for (int attempt = 0; attempt < 100 && fd < 0; ++attempt) {
+                path = target + ".tmp" + to_string(pid) + "." + to_string(counter++);
+                fd   = openFile(path, true);
+                if (fd < 0 && errno != EEXIST) break;
+            }
+        } else {
+            path = target;
+            fd   = openFile(path, false);
+        }
+#ifndef _WIN32
+        struct stat info;
+        if (fd >= 0 && opts.atomic && ::stat(target.c_str(), &info) == 0) {
+            fchmod(fd, info.st_mode & 07777);   // The replacement keeps the permissions
+        }
+#endif
+        if (fd < 0) {
+            fail("Could not create file " + path);
+            return;
+        }
+#if defined __linux__
+        if (opts.preallocate) fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(opts.preallocate));
+#endif
+        buffer.resize_uninitialized(max<size_t>(opts.buffer_size, 4096));
+    }
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    ~FileWriter() {
+        if (fd < 0) return;
+        if (opts.atomic) {
+            discard();
+            return;
+        }
+#if CLS_HAS_EXCEPT
+        try { close(); } catch (...) {}
+#else
+        close();
+#endif
+    }
+
+    FileWriter& write(const char* data, size_t n) {
+        if (fd < 0) return *this;
+        if (used + n <= buffer.size()) {
+            memcpy(buffer.data() + used, data, n);
+            used += n;
+            if (used == buffer.size()) flush();
+            return *this;
+        }
+        ByteView views[2] = {ByteView(buffer.data(), used), ByteView(data, n)};
+        output(views, 2);
+        return *this;
+    }
+
+    FileWriter& write(ByteView data) { return write(data.data(), data.size()); }
+
+    // Write a sequence of buffers (ByteArray, ByteView, string) with gathered writes
+    template<typename Container>
+    FileWriter& write_chain(const Container& chain) {
+        vector<ByteView> views;
+        views.reserve(chain.size() + 1);
+        views.emplace_back(buffer.data(), used);
+        for (auto& part : chain) views.emplace_back(part.data(), part.size());
+        output(views.data(), views.size());
+        return *this;
+    }
+
+    // Bytes written so far, buffered ones included
+    uint64_t size() const { return written + used; }
+
+    bool is_open() const { return fd >= 0; }
+    bool ok() const      { return !failed; }
+
+    // Hand the buffered data to the OS
+    void flush() {
+        if (fd < 0 || !used) return;
+        ByteView view(buffer.data(), used);
+        output(&view, 1);
+    }
+
+    // Flush and force the data to the device
+    void sync() {
+        flush();
+        if (fd >= 0 && !detail::syncFile(fd)) fail("Could not sync file " + path);
+        unsynced = 0;
+    }
+
+    // Finish the file: flush, sync by policy and replace the target in atomic mode
+    bool close() {
+        if (fd < 0) return !failed;
+        flush();
+        if (opts.sync != SyncPolicy::None && fd >= 0) sync();
+        if (failed) {   // Never publish data that didn't reach the file or the device
+            discard();
+            return false;
+        }
+#ifdef _WIN32
+        bool closed = _close(fd) == 0;
+#else
+        bool closed = ::close(fd) == 0;
+#endif
+        fd = -1;
+        if (!closed) {
+            if (opts.atomic) remove(path.c_str());
+            return fail("Could not close file " + path);
+        }
+        if (opts.atomic) {
+#ifdef _WIN32
+            bool renamed = MoveFileExA(path.c_str(), target.c_str(),
+                                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+            bool renamed = ::rename(path.c_str(), target.c_str()) == 0;
+#endif
+            if (!renamed) {
+                remove(path.c_str());
+                return fail("Could not replace file " + target);
+            }
+        }
+#ifndef _WIN32
+        // The new directory entry has to reach the device as well
+        if (opts.sync != SyncPolicy::None) {
+            auto slash = target.find_last_of('/');
+            auto dir   = slash == string::npos ? string(".") : target.substr(0, max<size_t>(slash, 1));
+            int dir_fd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+            if (dir_fd >= 0) {
+                fsync(dir_fd);
+                ::close(dir_fd);
+            }
+        }
+#endif
+        return !failed;
+    }
+
+    // Drop the data, an atomic writer leaves the target untouched
+    void discard() {
+        if (fd < 0) return;
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+        fd = -1;
+        if (opts.atomic) remove(path.c_str());
+    }
+
+private:
+    static int openFile(const string& file_name, bool exclusive) {
+#ifdef _WIN32
+        return _open(file_name.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY | (exclusive ? _O_EXCL : _O_TRUNC),
+                     _S_IREAD | _S_IWRITE);
+#else
+        return ::open(file_name.c_str(),
+                      O_WRONLY | O_CREAT | O_CLOEXEC | (exclusive ? O_EXCL | O_NOFOLLOW : O_TRUNC), 0666);
+#endif
+    }
+
+    void output(const ByteView* views, size_t n) {
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < n; ++i) bytes += views[i].size();
+        if (fd < 0 || !bytes) return;
+        if (!detail::writeAll(fd, views, n)) {
+            discard();
+            fail("Could not write file " + path);
+            return;
+        }
+        used      = 0;
+        written  += bytes;
+        unsynced += bytes;
+        if (opts.sync == SyncPolicy::EveryBytes && unsynced >= opts.sync_bytes) {
+            if (!detail::syncFile(fd)) fail("Could not sync file " + path);
+            unsynced = 0;
+        }
+    }
+
+    bool fail(const string& err_msg) {
+        failed = true;
+#if CLS_HAS_EXCEPT
+        throw FileExcept(err_msg);
+#else
+        cerr << err_msg << endl;
+        return false;
 #endif
     }
 
-    return vector<char>(ifsbuf_iter(ifs), ifsbuf_iter());
+    string target;
+    string path;
+    WriteOptions opts;
+    int fd = -1;
+    BasicByteArray<AlignedAllocator<char, 4096>> buffer;
+    size_t used       = 0;
+    uint64_t written  = 0;
+    uint64_t unsynced = 0;
+    bool failed       = false;
+};
+
+// Write data to file_name in one go, by default atomically and synced on close
+inline bool writeFile(const string& file_name, ByteView data, WriteOptions opts = WriteOptions())
+{
+    opts.buffer_size = 4096;
+    if (!opts.preallocate) opts.preallocate = data.size();
+    FileWriter writer(file_name, opts);
+    writer.write(data);
+    return writer.close();
+}
+
+// Write the concatenation of a sequence of buffers with gathered writes
+template<typename Container,
+         typename = typename enable_if<!is_same<typename Container::value_type, char>::value>::type>
+inline bool writeFile(const string& file_name, const Container& chain, WriteOptions opts = WriteOptions())
+{
+    opts.buffer_size = 4096;
+    FileWriter writer(file_name, opts);
+    writer.write_chain(chain);
+    return writer.close();
 }
 
 
+// gotoLine() and getLineStr() scan from the start on each call, build a LineIndex
+// (line_index.hpp) for repeated lookups
 inline ifstream& gotoLine(ifstream& file, int num)
 {
     file.seekg(ios::beg);
@@ -120,17 +838,129 @@ inline string getLineStr(const string& file_name, int num)
 }
 
 
-inline int countLine(const string& file_name)
+// Lines of a text in memory: every '\n' ends a line, and so does the end of a non-empty
+// text without a final '\n'. "\r\n" counts once since only '\n' is looked at. With a
+// pool the text is split into one chunk per worker.
+inline uint64_t countLines(ByteView data, ThreadPool* pool = nullptr)
 {
-    ifstream ifs (file_name);
+    if (data.empty()) return 0;
 
-    int count = 0;
-    string tmp;
-    while (getline(ifs, tmp)) {
-        ++count;
+    uint64_t count = 0;
+    auto chunks = pool ? min(pool->size(), max<size_t>(data.size() >> 22, 1)) : 1;
+    if (chunks == 1) {
+        count = detail::countByte(data.data(), data.size(), '\n');
+    } else {
+        auto chunk = (data.size() + chunks - 1) / chunks;
+        vector<future<size_t>> results;
+        for (size_t first = 0; first < data.size(); first += chunk) {
+            auto part = data.sub(first, chunk);
+            results.push_back(pool->submit([part] {
+                return detail::countByte(part.data(), part.size(), '\n');
+            }));
+        }
+        for (auto& result : results) count += result.get();
     }
+    return count + (data[data.size() - 1] != '\n');
+}
 
-    return count;
+namespace detail {
+// Line count of a file, false with a count of 0 if it can't be opened or read
+inline pair<bool, uint64_t> countFileLines(const string& file_name, ThreadPool* pool)
+{
+#ifdef _WIN32
+    FileInfo file_info;
+    if (!fileInfo(file_name, file_info) || !file_info.regular) return make_pair(false, uint64_t(0));
+    MappedFile mapped(file_name);
+    if (!mapped.is_open()) return make_pair(false, uint64_t(0));
+    mapped.advise(MappedFile::Advice::Sequential);
+    return make_pair(true, countLines(mapped.view(), pool));
+#else
+    int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return make_pair(false, uint64_t(0));
+
+    const size_t block_size = size_t(1) << 20;
+    // Count in [first, last) with pread, false on a read error
+    auto count_range = [fd, block_size](uint64_t first, uint64_t last, uint64_t& count) {
+        ByteArray buffer;
+        buffer.resize_uninitialized(static_cast<size_t>(min<uint64_t>(block_size, last - first)));
+        count = 0;
+        while (first < last) {
+            auto want  = static_cast<size_t>(min<uint64_t>(buffer.size(), last - first));
+            auto bytes = pread(fd, buffer.data(), want, static_cast<off_t>(first));
+            if (bytes < 0 && errno == EINTR) continue;
+            if (bytes <= 0) return false;
+            count += detail::countByte(buffer.data(), static_cast<size_t>(bytes), '\n');
+            first += static_cast<uint64_t>(bytes);
+        }
+        return true;
+    };
+
+    struct stat info;
+    uint64_t count = 0;
+    bool ok = true;
+    char last_byte = '\n';
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        auto size   = static_cast<uint64_t>(info.st_size);
+        auto chunks = pool ? min<uint64_t>(pool->size(), max<uint64_t>(size >> 24, 1)) : 1;
+        auto chunk  = (size + chunks - 1) / chunks;
+        vector<future<pair<bool, uint64_t>>> results;
+        for (uint64_t first = chunk; first < size; first += chunk) {
+            auto last = min(first + chunk, size);
+            results.push_back(pool->submit([&count_range, first, last] {
+                uint64_t part = 0;
+                bool part_ok = count_range(first, last, part);
+                return make_pair(part_ok, part);
+            }));
+        }
+        ok = count_range(0, min(chunk, size), count);
+        for (auto& result : results) {
+            auto part = result.get();
+            ok     = ok && part.first;
+            count += part.second;
+        }
+        if (ok && size) ok = pread(fd, &last_byte, 1, static_cast<off_t>(size - 1)) == 1;
+    } else {    // Pipes and files without a size (proc files) are read sequentially
+        ByteArray buffer;
+        buffer.resize_uninitialized(block_size);
+        while (true) {
+            auto bytes = ::read(fd, buffer.data(), block_size);
+            if (bytes < 0 && errno == EINTR) continue;
+            if (bytes <= 0) {
+                ok = bytes == 0;
+                break;
+            }
+            count    += detail::countByte(buffer.data(), static_cast<size_t>(bytes), '\n');
+            last_byte = buffer[bytes - 1];
+        }
+    }
+    ::close(fd);
+
+    if (!ok) return make_pair(false, uint64_t(0));
+    return make_pair(true, count + (last_byte != '\n'));
+#endif
+}
+} // End namespace detail
+
+// Lines of a file with the same rule, the result equals countLine(). Regular files are
+// read with pread() in blocks of 1 MB, in parallel ranges if a pool is given. Must not
+// be called from a task running on the same pool.
+inline uint64_t countLines(const string& file_name, ThreadPool* pool = nullptr)
+{
+    auto result = detail::countFileLines(file_name, pool);
+    if (!result.first) {
+#if CLS_HAS_EXCEPT
+        throw FileExcept("Could not read file " + file_name);
+#else
+        cerr << "Fail to read the file" << endl;
+#endif
+    }
+    return result.second;
+}
+
+// Kept for existing callers: 0 if the file can't be read instead of an error
+inline int countLine(const string& file_name)
+{
+    return static_cast<int>(detail::countFileLines(file_name, nullptr).second);
 }
 _CLS_END
 
@@ -0,0 +1,288 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_HASH_HPP
+#define CLS_HASH_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include "byte_array.hpp"
+#include "endian.hpp"
+
+#if CLS_HAS_SSE42
+#  include <nmmintrin.h>
+#endif
+
+_CLS_BEGIN
+namespace detail {
+inline uint64_t rotl64(uint64_t val, int bits)
+{
+    return (val << bits) | (val >> (64 - bits));
+}
+
+// Slicing-by-8 lookup tables of the Castagnoli polynomial (reflected 0x82F63B78)
+inline const uint32_t* crc32cTable()
+{
+    static const struct Table {
+        Table() {
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t crc = n;
+                for (int k = 0; k < 8; ++k) {
+                    crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+                }
+                data[n] = crc;
+            }
+            for (uint32_t n = 0; n < 256; ++n) {
+                for (int k = 1; k < 8; ++k) {
+                    auto prev = data[(k - 1) * 256 + n];
+                    data[k * 256 + n] = (prev >> 8) ^ data[prev & 0xFF];
+                }
+            }
+        }
+        uint32_t data[8 * 256];
+    } table;
+
+    return table.data;
+}
+
+inline uint32_t crc32cSoftware(uint32_t crc, const char* data, size_t len)
+{
+    auto table = crc32cTable();
+    auto ptr   = reinterpret_cast<const uchar*>(data);
+    for (; len >= 8; len -= 8, ptr += 8) {
+        auto lo = crc ^ loadLE<uint32_t>(ptr);
+        auto hi = loadLE<uint32_t>(ptr + 4);
+        crc = table[7 * 256 + ( lo        & 0xFF)] ^ table[6 * 256 + ((lo >> 8)  & 0xFF)] ^
+              table[5 * 256 + ((lo >> 16) & 0xFF)] ^ table[4 * 256 + ( lo >> 24)        ] ^
+              table[3 * 256 + ( hi        & 0xFF)] ^ table[2 * 256 + ((hi >> 8)  & 0xFF)] ^
+              table[1 * 256 + ((hi >> 16) & 0xFF)] ^ table[          ( hi >> 24)        ];
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ table[(crc ^ *ptr++) & 0xFF];
+    }
+    return crc;
+}
+
+#if CLS_HAS_SSE42
+inline uint32_t crc32cHardware(uint32_t crc, const char* data, size_t len)
+{
+#  if defined __x86_64__ || defined _M_X64
+    uint64_t crc64 = crc;
+    for (; len >= 8; len -= 8, data += 8) {
+        uint64_t val;
+        memcpy(&val, data, sizeof(val));
+        crc64 = _mm_crc32_u64(crc64, val);
+    }
+    crc = static_cast<uint32_t>(crc64);
+#  endif
+    for (; len >= 4; len -= 4, data += 4) {
+        uint32_t val;
+        memcpy(&val, data, sizeof(val));
+        crc = _mm_crc32_u32(crc, val);
+    }
+    while (len--) {
+        crc = _mm_crc32_u8(crc, static_cast<uchar>(*data++));
+    }
+    return crc;
+}
+#endif
+} // End namespace detail
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// CRC-32C (Castagnoli), uses the SSE4.2 crc32 instruction when it is enabled at
+// compile time and falls back to a slicing-by-8 table otherwise.
+// Feeding the data in several update() calls gives the same value as a single call.
+class Crc32c {
+public:
+    explicit Crc32c(uint32_t seed = 0) : state(~seed) {}
+
+    Crc32c& update(const void* data, size_t len) {
+        auto ptr = static_cast<const char*>(data);
+#if CLS_HAS_SSE42
+        state = detail::crc32cHardware(state, ptr, len);
+#else
+        state = detail::crc32cSoftware(state, ptr, len);
+#endif
+        return *this;
+    }
+
+    Crc32c& update(ByteView data) {
+        return update(data.data(), data.size());
+    }
+
+    uint32_t value() const { return ~state; }
+
+    void reset(uint32_t seed = 0) { state = ~seed; }
+
+private:
+    uint32_t state;
+};
+
+inline uint32_t crc32c(const void* data, size_t len, uint32_t seed = 0)
+{
+    return Crc32c(seed).update(data, len).value();
+}
+
+inline uint32_t crc32c(ByteView data, uint32_t seed = 0)
+{
+    return crc32c(data.data(), data.size(), seed);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Fast 64-bit non-cryptographic hash, produces the same values as XXH64.
+// Input is consumed in 32 byte stripes, only the tail is buffered between updates.
+class Hash64 {
+    static const uint64_t P1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t P3 = 0x165667B19E3779F9ULL;
+    static const uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t P5 = 0x27D4EB2F165667C5ULL;
+    static const size_t STRIPE = 32;
+
+public:
+    explicit Hash64(uint64_t seed = 0) { reset(seed); }
+
+    void reset(uint64_t seed = 0) {
+        init_seed = seed;
+        acc[0]    = seed + P1 + P2;
+        acc[1]    = seed + P2;
+        acc[2]    = seed;
+        acc[3]    = seed - P1;
+        total_len = 0;
+        buf_size  = 0;
+    }
+
+    Hash64& update(const void* data, size_t len) {
+        auto ptr = static_cast<const char*>(data);
+        total_len += len;
+
+        if (buf_size + len < STRIPE) {
+            memcpy(buffer + buf_size, ptr, len);
+            buf_size += len;
+            return *this;
+        }
+
+        if (buf_size > 0) {
+            auto fill_size = STRIPE - buf_size;
+            memcpy(buffer + buf_size, ptr, fill_size);
+            consume(buffer);
+            ptr += fill_size;
+            len -= fill_size;
+            buf_size = 0;
+        }
+
+        for (; len >= STRIPE; len -= STRIPE, ptr += STRIPE) {
+            consume(ptr);
+        }
+
+        memcpy(buffer, ptr, len);
+        buf_size = len;
+        return *this;
+    }
+
+    Hash64& update(ByteView data) {
+        return update(data.data(), data.size());
+    }
+
+    uint64_t digest() const {
+        uint64_t h;
+        if (total_len >= STRIPE) {
+            h = detail::rotl64(acc[0], 1)  + detail::rotl64(acc[1], 7) +
+                detail::rotl64(acc[2], 12) + detail::rotl64(acc[3], 18);
+            for (auto val : acc) {
+                h ^= round(0, val);
+                h  = h * P1 + P4;
+            }
+        } else {
+            h = init_seed + P5;
+        }
+        h += total_len;
+
+        auto ptr = buffer;
+        auto len = buf_size;
+        for (; len >= 8; len -= 8, ptr += 8) {
+            h ^= round(0, loadLE<uint64_t>(ptr));
+            h  = detail::rotl64(h, 27) * P1 + P4;
+        }
+        if (len >= 4) {
+            h ^= loadLE<uint32_t>(ptr) * P1;
+            h  = detail::rotl64(h, 23) * P2 + P3;
+            ptr += 4;
+            len -= 4;
+        }
+        while (len--) {
+            h ^= static_cast<uchar>(*ptr++) * P5;
+            h  = detail::rotl64(h, 11) * P1;
+        }
+
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * P2;
+        return detail::rotl64(acc, 31) * P1;
+    }
+
+    void consume(const char* stripe) {
+        acc[0] = round(acc[0], loadLE<uint64_t>(stripe));
+        acc[1] = round(acc[1], loadLE<uint64_t>(stripe + 8));
+        acc[2] = round(acc[2], loadLE<uint64_t>(stripe + 16));
+        acc[3] = round(acc[3], loadLE<uint64_t>(stripe + 24));
+    }
+
+    uint64_t acc[4];
+    uint64_t init_seed;
+    uint64_t total_len;
+    char     buffer[STRIPE];
+    size_t   buf_size;
+};
+
+inline uint64_t hash64(const void* data, size_t len, uint64_t seed = 0)
+{
+    return Hash64(seed).update(data, len).digest();
+}
+
+inline uint64_t hash64(ByteView data, uint64_t seed = 0)
+{
+    return hash64(data.data(), data.size(), seed);
+}
+_CLS_END
+
+namespace std {
+template<typename Alloc>
+struct hash<cls::BasicByteArray<Alloc>> {
+    size_t operator()(const cls::BasicByteArray<Alloc>& data) const {
+        return static_cast<size_t>(cls::hash64(data));
+    }
+};
+} // End namespace std
+
+#endif // CLS_HASH_HPP
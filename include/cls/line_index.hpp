@@ -0,0 +1,157 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_LINE_INDEX_HPP
+#define CLS_LINE_INDEX_HPP
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include "file_sys.hpp"
+#include "byte_array.hpp"
+#include "byte_io.hpp"
+
+_CLS_BEGIN
+//////////////////////////////////////////////////////////////////////////////////////////
+// Start offsets of all lines of a memory mapped file, built by one newline scan. Lines
+// are numbered from 0 (getLineStr(file, idx + 1) is line idx here), a line excludes its
+// '\n' and the last line doesn't need one, so size() is the same count as countLine().
+//
+// With a cache file the offsets are stored next to the text and reused while the size
+// and modification time of the text stay the same.
+class LineIndex {
+public:
+    LineIndex() = default;
+
+    explicit LineIndex(const string& file_name, const string& cache_file = string())
+        : mapped(file_name) {
+        fileInfo(file_name, info);
+        info.size = mapped.size();
+        if (!cache_file.empty() && loadCache(cache_file)) return;
+        build();
+        if (!cache_file.empty()) saveCache(cache_file);
+    }
+
+    size_t size() const { return starts.empty() ? 0 : starts.size() - 1; }
+    bool empty() const  { return size() == 0; }
+
+    // Line idx without its '\n', a view into the mapped file
+    ByteView operator[](size_t idx) const {
+        auto first = starts[idx];
+        return ByteView(mapped.data() + first, static_cast<size_t>(starts[idx + 1] - 1 - first));
+    }
+
+    ByteView line(size_t idx) const {
+#if CLS_HAS_EXCEPT
+        if (idx >= size()) throw out_of_range("line index out of range");
+#endif
+        return (*this)[idx];
+    }
+
+    // Byte offset of the start of line idx, idx == size() gives the file size
+    uint64_t offset(size_t idx) const {
+        return idx < size() ? starts[idx] : mapped.size();
+    }
+
+    const MappedFile& file() const { return mapped; }
+
+    // True if the offsets were loaded from the cache file instead of scanning the text
+    bool cached() const { return from_cache; }
+
+    // Cache layout: "CLSLIDX1", uint32 byte order mark, uint64 text size, int64 mtime,
+    // uint64 offset count, offsets in native byte order
+    bool saveCache(const string& cache_file) const {
+        ByteArray buffer;
+        {
+            ByteWriter writer(buffer, 36 + starts.size() * sizeof(uint64_t));
+            writer.putBytes(ByteView(MAGIC, 8)).putLE(BYTE_ORDER_MARK)
+                  .putLE(info.size).putLE(info.mtime_ns).putLE(uint64_t(starts.size()))
+                  .putSpan(starts);
+        }
+        ofstream ofs(cache_file, ios::binary);
+        return ofs.write(buffer.data(), buffer.size()).good();
+    }
+
+private:
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr const char* MAGIC = "CLSLIDX1";
+
+    // starts holds one offset past each '\n' and a sentinel for an unterminated last
+    // line, so line idx always ends one byte before starts[idx + 1]
+    void build() {
+        auto data = mapped.data();
+        auto n    = mapped.size();
+        starts.clear();
+        starts.reserve(n / 64 + 2);
+        starts.push_back(0);
+        mapped.advise(MappedFile::Advice::Sequential);
+        detail::forEachByte(data, n, '\n', [this](size_t idx) {
+            starts.push_back(idx + 1);
+        });
+        if (n && data[n - 1] != '\n') starts.push_back(n + 1);
+        mapped.advise(MappedFile::Advice::Normal);
+        from_cache = false;
+    }
+
+    bool loadCache(const string& cache_file) {
+        FileInfo cache_info;
+        if (!fileInfo(cache_file, cache_info) || !cache_info.regular) return false;
+        auto buffer = readBinaryFile(cache_file);
+        ByteReader reader(buffer);
+        ByteView magic;
+        uint32_t mark  = 0;
+        uint64_t size  = 0, count = 0;
+        int64_t  mtime = 0;
+        if (!reader.getBytes(8, magic) || magic != ByteView(MAGIC, 8) ||
+            !reader.getLE(mark) || mark != BYTE_ORDER_MARK ||
+            !reader.getLE(size) || size != info.size ||
+            !reader.getLE(mtime) || mtime != info.mtime_ns ||
+            !reader.getLE(count) || count == 0 || count * sizeof(uint64_t) != reader.remaining()) {
+            return false;
+        }
+        starts.resize(static_cast<size_t>(count));
+        reader.getSpan(starts.data(), starts.size());
+        // Corrupt offsets would make operator[] produce views outside the file
+        bool increasing = adjacent_find(starts.begin(), starts.end(), [](uint64_t prev, uint64_t next) {
+            return next <= prev;
+        }) == starts.end();
+        if (starts.front() != 0 || starts.back() > size + 1 || !increasing) {
+            starts.clear();
+            return false;
+        }
+        from_cache = true;
+        return true;
+    }
+
+    MappedFile mapped;
+    FileInfo info;
+    vector<uint64_t> starts;
+    bool from_cache = false;
+};
+_CLS_END
+
+#endif // CLS_LINE_INDEX_HPP
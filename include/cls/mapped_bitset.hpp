@@ -0,0 +1,332 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_MAPPED_BITSET_HPP
+#define CLS_MAPPED_BITSET_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "file_sys.hpp"
+#include "bit_ops.hpp"
+#include "dyn_bitset.hpp"
+
+_CLS_BEGIN
+//////////////////////////////////////////////////////////////////////////////////////////
+// Bitset stored in a memory mapped file. Opening only maps the file, pages are read on
+// first access, so a multi gigabyte bitset is usable at once and only the touched parts
+// take memory. Indexing and the queries are the same as DynBitset.
+//
+// File layout: a 64 byte header ("CLSBITS1", uint64 bit count, uint32 byte order mark,
+// zero padding) followed by the words of DynBitset::data() in native byte order. The
+// words start 64 bytes into a page aligned mapping so the word kernels see aligned data.
+// A file written on a machine of the other endianness fails the byte order check.
+class MappedBitset {
+public:
+    using Word = uint64_t;
+    static const size_t npos = size_t(-1);
+
+    MappedBitset() : words(nullptr), bit_size(0), word_count(0) {}
+
+    explicit MappedBitset(const string& file_name, bool writable = true)
+        : file(file_name, writable ? MappedFile::Access::ReadWrite : MappedFile::Access::ReadOnly),
+          words(nullptr), bit_size(0), word_count(0) {
+        if (file.is_open()) attach(file_name);
+    }
+
+    // Create or overwrite file_name with n zero bits
+    static MappedBitset create(const string& file_name, size_t n) {
+        MappedBitset bits;
+        auto num_words = (n + 63) / 64;
+        bits.file = MappedFile::create(file_name, HEADER_SIZE + num_words * sizeof(Word));
+        if (!bits.file.is_open()) return bits;
+        auto header = bits.file.data();
+        memcpy(header, MAGIC, 8);
+        uint64_t size = n;
+        uint32_t mark = BYTE_ORDER_MARK;
+        memcpy(header + 8, &size, sizeof(size));
+        memcpy(header + 16, &mark, sizeof(mark));
+        bits.words      = reinterpret_cast<Word*>(header + HEADER_SIZE);
+        bits.bit_size   = n;
+        bits.word_count = num_words;
+        return bits;
+    }
+
+    static MappedBitset create(const string& file_name, const DynBitset& bits) {
+        auto result = create(file_name, bits.size());
+        if (result.is_open() && bits.num_words()) {
+            memcpy(result.words, bits.data(), bits.num_words() * sizeof(Word));
+        }
+        return result;
+    }
+
+    bool is_open() const  { return file.is_open(); }
+    bool writable() const { return file.writable(); }
+
+    size_t size() const      { return bit_size; }
+    size_t num_words() const { return word_count; }
+
+    // Raw words in DynBitset layout, the padding bits must stay zero
+    Word* data()             { return words; }
+    const Word* data() const { return words; }
+
+    bool operator[](size_t idx) const {
+        auto pos = bit_size - 1 - idx;
+        return (words[pos / 64] & maskOf(pos)) != 0;
+    }
+
+    bool test(size_t idx) const {
+#if CLS_HAS_EXCEPT
+        if (idx >= bit_size) throw range_error("bitset subscript out of range");
+#endif
+        return (*this)[idx];
+    }
+
+    size_t count() const { return popcount(words, word_count); }
+
+    bool any() const {
+        return any_of(words, words + word_count, [](Word word) { return word != 0; });
+    }
+
+    bool none() const { return !any(); }
+
+    bool all() const {
+        if (word_count == 0) return true;
+        bool all_set = all_of(words, words + word_count - 1, [](Word word) {
+            return word == ~Word(0);
+        });
+        return all_set && words[word_count - 1] == lastWordMask();
+    }
+
+    // Bit operation, the bitset must be opened writable
+    MappedBitset& set() {
+        if (!checkWritable()) return *this;
+        fill(words, words + word_count, ~Word(0));
+        clearPadding();
+        return *this;
+    }
+
+    MappedBitset& set(size_t idx, bool val = true) {
+        ASSERT(idx < bit_size);
+        if (!checkWritable()) return *this;
+        auto pos = bit_size - 1 - idx;
+        if (val) words[pos / 64] |= maskOf(pos);
+        else     words[pos / 64] &= ~maskOf(pos);
+        return *this;
+    }
+
+    MappedBitset& reset() {
+        if (!checkWritable()) return *this;
+        fill(words, words + word_count, Word(0));
+        return *this;
+    }
+
+    MappedBitset& reset(size_t idx) { return set(idx, false); }
+
+    MappedBitset& flip() {
+        if (!checkWritable()) return *this;
+        for (size_t w = 0; w < word_count; ++w) words[w] = ~words[w];
+        clearPadding();
+        return *this;
+    }
+
+    MappedBitset& flip(size_t idx) {
+        ASSERT(idx < bit_size);
+        if (!checkWritable()) return *this;
+        auto pos = bit_size - 1 - idx;
+        words[pos / 64] ^= maskOf(pos);
+        return *this;
+    }
+
+    // Bitwise algebra with a bitset of the same size, in memory or mapped
+    template<typename Bitset>
+    MappedBitset& operator&=(const Bitset& other) {
+        if (!checkSize(other.size())) return *this;
+        andWords(words, other.data(), word_count);
+        return *this;
+    }
+
+    template<typename Bitset>
+    MappedBitset& operator|=(const Bitset& other) {
+        if (!checkSize(other.size())) return *this;
+        orWords(words, other.data(), word_count);
+        return *this;
+    }
+
+    template<typename Bitset>
+    MappedBitset& operator^=(const Bitset& other) {
+        if (!checkSize(other.size())) return *this;
+        xorWords(words, other.data(), word_count);
+        return *this;
+    }
+
+    // this & ~other
+    template<typename Bitset>
+    MappedBitset& andNot(const Bitset& other) {
+        if (!checkSize(other.size())) return *this;
+        andNotWords(words, other.data(), word_count);
+        return *this;
+    }
+
+    // Set bit search by index, same as DynBitset
+    size_t find_first() const { return toIndex(detail::findLastPos(words, bit_size, npos)); }
+    size_t find_last() const  { return toIndex(detail::findFirstPos(words, bit_size, 0)); }
+
+    size_t find_next(size_t idx) const {
+        if (bit_size == 0 || idx >= bit_size - 1) return npos;
+        return toIndex(detail::findLastPos(words, bit_size, bit_size - 2 - idx));
+    }
+
+    size_t find_prev(size_t idx) const {
+        if (idx == 0) return npos;
+        return toIndex(detail::findFirstPos(words, bit_size, bit_size - min(idx, bit_size)));
+    }
+
+    template<typename Func>
+    void for_each_set(Func func) const {
+        for (size_t w = word_count; w-- > 0;) {
+            auto word = words[w];
+            auto base = bit_size - 64 * (w + 1);
+            while (word) {
+                func(base + ctz(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    DynBitset toDynBitset() const {
+        DynBitset bits(bit_size);
+        if (word_count) memcpy(bits.data(), words, word_count * sizeof(Word));
+        return bits;
+    }
+
+    // Write the dirty pages back to the file before returning
+    void flush() { file.flush(); }
+
+    void close() {
+        file.close();
+        words      = nullptr;
+        bit_size   = 0;
+        word_count = 0;
+    }
+
+private:
+    static const size_t HEADER_SIZE = 64;
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr const char* MAGIC = "CLSBITS1";
+
+    void attach(const string& file_name) {
+        auto header = file.data();
+        uint64_t size = 0;
+        uint32_t mark = 0;
+        if (file.size() >= HEADER_SIZE) {
+            memcpy(&size, header + 8, sizeof(size));
+            memcpy(&mark, header + 16, sizeof(mark));
+        }
+        auto num_words = (size + 63) / 64;
+        if (file.size() < HEADER_SIZE || memcmp(header, MAGIC, 8) != 0 ||
+            mark != BYTE_ORDER_MARK || size > (file.size() - HEADER_SIZE) * 8 ||
+            file.size() != HEADER_SIZE + num_words * sizeof(Word)) {
+            file.close();
+            string err_msg = "Invalid bitset file " + file_name;
+#if CLS_HAS_EXCEPT
+            throw FileExcept(err_msg);
+#else
+            cerr << err_msg << endl;
+            return;
+#endif
+        }
+        words      = reinterpret_cast<Word*>(header + HEADER_SIZE);
+        bit_size   = static_cast<size_t>(size);
+        word_count = static_cast<size_t>(num_words);
+    }
+
+    // A read-only mapping would fault on the first write
+    bool checkWritable() const {
+        if (writable()) return true;
+#if CLS_HAS_EXCEPT
+        throw FileExcept("Bitset file is opened read-only");
+#else
+        cerr << "Bitset file is opened read-only" << endl;
+        return false;
+#endif
+    }
+
+    bool checkSize(size_t n) const {
+        return checkWritable() && detail::checkSameSize(bit_size, n);
+    }
+
+    static Word maskOf(size_t pos) {
+        return Word(1) << (63 - pos % 64);
+    }
+
+    size_t toIndex(size_t pos) const {
+        return pos == npos ? npos : bit_size - 1 - pos;
+    }
+
+    Word lastWordMask() const {
+        return ~Word(0) << (64 * word_count - bit_size);
+    }
+
+    void clearPadding() {
+        if (word_count) words[word_count - 1] &= lastWordMask();
+    }
+
+    MappedFile file;
+    Word* words;
+    size_t bit_size;
+    size_t word_count;
+};
+
+// Fused counts against a bitset of the same size
+template<typename Bitset>
+inline size_t countAnd(const MappedBitset& left, const Bitset& right)
+{
+    if (!detail::checkSameSize(left.size(), right.size())) return 0;
+    return popcountAnd(left.data(), right.data(), left.num_words());
+}
+
+template<typename Bitset>
+inline size_t countOr(const MappedBitset& left, const Bitset& right)
+{
+    if (!detail::checkSameSize(left.size(), right.size())) return 0;
+    return popcountOr(left.data(), right.data(), left.num_words());
+}
+
+template<typename Bitset>
+inline size_t countXor(const MappedBitset& left, const Bitset& right)
+{
+    if (!detail::checkSameSize(left.size(), right.size())) return 0;
+    return popcountXor(left.data(), right.data(), left.num_words());
+}
+
+template<typename Bitset>
+inline size_t countAndNot(const MappedBitset& left, const Bitset& right)
+{
+    if (!detail::checkSameSize(left.size(), right.size())) return 0;
+    return popcountAndNot(left.data(), right.data(), left.num_words());
+}
+_CLS_END
+
+#endif // CLS_MAPPED_BITSET_HPP
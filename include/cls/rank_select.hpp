@@ -0,0 +1,201 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_RANK_SELECT_HPP
+#define CLS_RANK_SELECT_HPP
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "dyn_bitset.hpp"
+#include "bit_ops.hpp"
+
+_CLS_BEGIN
+// Rank/select index over a static DynBitset. The bitset is referenced, not copied, it
+// must outlive the index and must not change after build().
+//
+// Layout: one 64-bit entry per 2048-bit superblock (four 512-bit cache lines) holding
+// the ones before the superblock in the low 32 bits and the cumulative counts of its
+// first three cache lines in 10 + 11 + 11 bits. A 64-bit base every 2^32 bits removes
+// the 32-bit limit and every 8192nd one records its superblock to start select().
+// That is 3.1% on top of the bitmap, plus at most 0.4% for the select samples.
+class RankSelect {
+    static const size_t SUPER_BITS   = 2048;
+    static const size_t BLOCK_WORDS  = 8;
+    static const size_t SAMPLE_RATE  = 8192;
+    static const size_t BASE_SHIFT   = 32;
+
+public:
+    static const size_t npos = size_t(-1);
+
+    RankSelect() : words(nullptr), num_words(0), bit_size(0), num_ones(0) {}
+    explicit RankSelect(const DynBitset& bits) {
+        build(bits);
+    }
+
+    void build(const DynBitset& bits) {
+        words     = bits.data();
+        num_words = bits.num_words();
+        bit_size  = bits.size();
+
+        auto num_super = (bit_size + SUPER_BITS - 1) / SUPER_BITS;
+        entries.assign(num_super + 1, 0);
+        bases.assign(((num_super * SUPER_BITS) >> BASE_SHIFT) + 1, 0);
+        samples.clear();
+
+        size_t total = 0;
+        for (size_t sb = 0; sb <= num_super; ++sb) {
+            auto base_idx = (sb * SUPER_BITS) >> BASE_SHIFT;
+            if (((sb * SUPER_BITS) & ((uint64_t(1) << BASE_SHIFT) - 1)) == 0) {
+                bases[base_idx] = total;
+            }
+            uint64_t entry = total - bases[base_idx];
+            size_t in_super = 0;
+            for (size_t blk = 0; blk < 4; ++blk) {
+                if (blk > 0) entry |= uint64_t(in_super) << subShift(blk);
+                auto first = (sb * 4 + blk) * BLOCK_WORDS;
+                auto last  = min(first + BLOCK_WORDS, num_words);
+                if (first < last) in_super += popcount(words + first, last - first);
+            }
+            entries[sb] = entry;
+            // Superblocks holding the sampled ones
+            for (auto next = samples.size() * SAMPLE_RATE; next < total + in_super; next += SAMPLE_RATE) {
+                samples.push_back(static_cast<uint32_t>(sb));
+            }
+            total += in_super;
+        }
+        num_ones = total;
+        samples.push_back(static_cast<uint32_t>(num_super));
+    }
+
+    size_t size() const  { return bit_size; }
+    size_t count() const { return num_ones; }
+
+    // Number of ones at indices below idx, idx <= size()
+    size_t rank(size_t idx) const {
+        return num_ones - rankPos(bit_size - idx);
+    }
+
+    // Number of zeros at indices below idx
+    size_t rank0(size_t idx) const {
+        return idx - rank(idx);
+    }
+
+    // Index of the k-th one counting from 0, npos if k >= count()
+    size_t select(size_t k) const {
+        if (k >= num_ones) return npos;
+        return bit_size - 1 - selectPos(num_ones - 1 - k);
+    }
+
+    // Bulk rank, prefetching the entries and words a few queries ahead
+    void rank(const size_t* idx, size_t n, size_t* out) const {
+        const size_t ahead = 16;
+        for (size_t i = 0; i < min(ahead, n); ++i) prefetchPos(bit_size - idx[i]);
+        for (size_t i = 0; i < n; ++i) {
+            if (i + ahead < n) prefetchPos(bit_size - idx[i + ahead]);
+            out[i] = rank(idx[i]);
+        }
+    }
+
+    vector<size_t> rank(const vector<size_t>& idx) const {
+        vector<size_t> result(idx.size());
+        rank(idx.data(), idx.size(), result.data());
+        return result;
+    }
+
+    // Bytes used by the index itself
+    size_t memory_usage() const {
+        return entries.size() * sizeof(uint64_t) + bases.size() * sizeof(uint64_t) +
+               samples.size() * sizeof(uint32_t);
+    }
+
+private:
+    static int subShift(size_t blk) {
+        return blk == 1 ? 32 : blk == 2 ? 42 : 53;
+    }
+
+    static size_t subCount(uint64_t entry, size_t blk) {
+        if (blk == 0) return 0;
+        auto shift = subShift(blk);
+        return (entry >> shift) & (blk == 1 ? 0x3FF : 0x7FF);
+    }
+
+    // Ones before superblock sb
+    size_t superRank(size_t sb) const {
+        return bases[(sb * SUPER_BITS) >> BASE_SHIFT] + (entries[sb] & 0xFFFFFFFF);
+    }
+
+    // Number of ones at string positions below pos, the storage order of DynBitset
+    size_t rankPos(size_t pos) const {
+        auto sb    = pos / SUPER_BITS;
+        auto blk   = pos / (BLOCK_WORDS * 64) % 4;
+        auto result = superRank(sb) + subCount(entries[sb], blk);
+        auto w     = pos / SUPER_BITS * (4 * BLOCK_WORDS) + blk * BLOCK_WORDS;
+        for (auto last = pos / 64; w < last; ++w) result += popcount(words[w]);
+        if (pos % 64) result += popcount(words[w] >> (64 - pos % 64));
+        return result;
+    }
+
+    // String position of the j-th one
+    size_t selectPos(size_t j) const {
+        // Last superblock with superRank <= j between the surrounding samples
+        size_t lo = samples[j / SAMPLE_RATE], hi = samples[j / SAMPLE_RATE + 1];
+        while (lo < hi) {
+            auto mid = lo + (hi - lo + 1) / 2;
+            if (superRank(mid) <= j) lo = mid;
+            else                     hi = mid - 1;
+        }
+        auto sb  = lo;
+        auto rem = j - superRank(sb);
+        size_t blk = 3;
+        while (blk > 0 && subCount(entries[sb], blk) > rem) --blk;
+        rem -= subCount(entries[sb], blk);
+
+        auto w = (sb * 4 + blk) * BLOCK_WORDS;
+        for (;; ++w) {
+            size_t ones = popcount(words[w]);
+            if (rem < ones) break;
+            rem -= ones;
+        }
+        // rem-th one from the most significant bit
+        auto bit = selectBit(words[w], static_cast<int>(popcount(words[w]) - 1 - rem));
+        return w * 64 + 63 - bit;
+    }
+
+    void prefetchPos(size_t pos) const {
+        prefetch(&entries[pos / SUPER_BITS]);
+        if (pos / 64 < num_words) prefetch(&words[pos / 64]);
+    }
+
+    const uint64_t* words;
+    size_t num_words;
+    size_t bit_size;
+    size_t num_ones;
+    vector<uint64_t> entries;
+    vector<uint64_t> bases;
+    vector<uint32_t> samples;
+};
+_CLS_END
+
+#endif // CLS_RANK_SELECT_HPP
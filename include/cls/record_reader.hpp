@@ -0,0 +1,181 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_RECORD_READER_HPP
+#define CLS_RECORD_READER_HPP
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include "file_sys.hpp"
+#include "byte_array.hpp"
+
+_CLS_BEGIN
+//////////////////////////////////////////////////////////////////////////////////////////
+// Split a file or a buffer into delimiter separated records, one at a time. The records
+// are views without the delimiter, a non-empty tail without one is the last record
+// (the same rule as countLine()). Files are read in blocks into one reusable buffer,
+// so memory stays bounded whatever the file size; the buffer only grows for a record
+// longer than itself. A buffer source, e.g. MappedFile::view(), is split in place.
+//
+// A view is valid until the next record is read. The reader is also a single pass
+// input range, so range-for and the algorithm.hpp overloads work on it.
+class RecordReader {
+public:
+    class iterator {
+    public:
+        using iterator_category = input_iterator_tag;
+        using value_type        = ByteView;
+        using difference_type   = ptrdiff_t;
+        using pointer           = const ByteView*;
+        using reference         = const ByteView&;
+
+        iterator() : reader(nullptr) {}
+        explicit iterator(RecordReader* source) : reader(source) { ++(*this); }
+
+        reference operator*() const { return record; }
+        pointer operator->() const  { return &record; }
+
+        iterator& operator++() {
+            if (!reader->next(record)) reader = nullptr;
+            return *this;
+        }
+
+        // Only for the comparison with end(), the record is gone
+        iterator operator++(int) {
+            auto tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        bool operator==(const iterator& other) const { return reader == other.reader; }
+        bool operator!=(const iterator& other) const { return reader != other.reader; }
+
+    private:
+        RecordReader* reader;
+        ByteView record;
+    };
+    using const_iterator = iterator;
+
+    explicit RecordReader(const string& file_name, char delimiter = '\n',
+                          size_t buffer_size = size_t(1) << 20)
+        : ifs(file_name, ios::binary), streaming(true), delim(delimiter) {
+        if (!ifs) {
+#if CLS_HAS_EXCEPT
+            throw FileExcept("Could not open file " + file_name);
+#else
+            cerr << "Fail to open the file" << endl;
+            streaming = false;
+#endif
+        }
+        buffer.resize_uninitialized(max<size_t>(buffer_size, 16));
+        cur = last = scan = buffer.data();
+    }
+
+    explicit RecordReader(ByteView data, char delimiter = '\n')
+        : streaming(false), delim(delimiter),
+          cur(data.begin()), last(data.end()), scan(data.begin()) {}
+
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    // Next record, false after the last one
+    bool next(ByteView& record) {
+        while (true) {
+            auto found = scan == last ? nullptr
+                       : static_cast<const char*>(memchr(scan, delim, last - scan));
+            if (found) {
+                record = ByteView(cur, found - cur);
+                cur = scan = found + 1;
+                ++num_records;
+                return true;
+            }
+            scan = last;
+            if (!streaming) {
+                if (cur == last) return false;
+                record = ByteView(cur, last - cur);
+                cur = scan;
+                ++num_records;
+                return true;
+            }
+            refill();
+        }
+    }
+
+    // Number of records read so far
+    size_t records() const { return num_records; }
+
+    char delimiter() const { return delim; }
+
+    iterator begin() { return iterator(this); }
+    iterator end()   { return iterator(); }
+
+private:
+    // Move the partial record to the front and read behind it, streaming stops at EOF
+    void refill() {
+        auto keep = static_cast<size_t>(last - cur);
+        if (keep) memmove(buffer.data(), cur, keep);
+        if (keep == buffer.size()) buffer.resize_uninitialized(buffer.size() * 2);
+
+        auto want = buffer.size() - keep;
+        ifs.read(buffer.data() + keep, want);
+        auto got = static_cast<size_t>(ifs.gcount());
+        if (ifs.bad()) {
+#if CLS_HAS_EXCEPT
+            throw FileExcept("Could not read file");
+#else
+            cerr << "Fail to read the file" << endl;
+            got = 0;
+#endif
+        }
+        if (got < want) streaming = false;
+
+        cur  = buffer.data();
+        scan = cur + keep;
+        last = scan + got;
+    }
+
+    ifstream ifs;
+    ByteArray buffer;
+    bool streaming;
+    char delim;
+    const char* cur;
+    const char* last;
+    const char* scan;
+    size_t num_records = 0;
+};
+
+// RecordReader split at '\n', the lines keep a '\r' before it like getLineStr()
+class LineReader : public RecordReader {
+public:
+    explicit LineReader(const string& file_name, size_t buffer_size = size_t(1) << 20)
+        : RecordReader(file_name, '\n', buffer_size) {}
+
+    explicit LineReader(ByteView data)
+        : RecordReader(data, '\n') {}
+};
+_CLS_END
+
+#endif // CLS_RECORD_READER_HPP
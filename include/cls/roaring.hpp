@@ -0,0 +1,855 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_ROARING_HPP
+#define CLS_ROARING_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <initializer_list>
+#include "byte_array.hpp"
+#include "byte_io.hpp"
+#include "endian.hpp"
+#include "bit_ops.hpp"
+#include "dyn_bitset.hpp"
+
+_CLS_BEGIN
+enum class RoaringOp { And, Or, Xor, AndNot };
+
+namespace detail {
+// Set bits first..last (inclusive) of a 65536-bit word array
+inline void setBitRange(uint64_t* words, uint32_t first, uint32_t last)
+{
+    auto first_word = first / 64, last_word = last / 64;
+    auto first_mask = ~uint64_t(0) << (first % 64);
+    auto last_mask  = ~uint64_t(0) >> (63 - last % 64);
+    if (first_word == last_word) {
+        words[first_word] |= first_mask & last_mask;
+        return;
+    }
+    words[first_word] |= first_mask;
+    fill(words + first_word + 1, words + last_word, ~uint64_t(0));
+    words[last_word] |= last_mask;
+}
+
+// Container of the low 16 bits of the values sharing the same high 16 bits. Arrays hold
+// up to ARRAY_MAX sorted values, bitmaps the rest. Runs come from addRange() and
+// runOptimize(), other updates turn them back into arrays or bitmaps.
+struct RoaringContainer {
+    enum Type : uint8_t { Array, Bitmap, Run };
+    static const uint32_t ARRAY_MAX = 4096;
+    static const size_t   NUM_WORDS = 1024;
+
+    Type     type = Array;
+    uint32_t card = 0;
+    vector<uint16_t> values;    // Sorted values, or (start, length - 1) pairs of runs
+    vector<uint64_t> words;     // Value v is bit v % 64 of word v / 64
+
+    static RoaringContainer range(uint32_t first, uint32_t last) {
+        RoaringContainer result;
+        result.type   = Run;
+        result.card   = last - first + 1;
+        result.values = {static_cast<uint16_t>(first), static_cast<uint16_t>(last - first)};
+        return result;
+    }
+
+    bool contains(uint16_t val) const {
+        switch (type) {
+        case Array:
+            return binary_search(values.begin(), values.end(), val);
+        case Bitmap:
+            return (words[val / 64] >> (val % 64)) & 1;
+        default: {
+            // Last run starting at or before val
+            size_t lo = 0, hi = values.size() / 2;
+            while (lo < hi) {
+                auto mid = (lo + hi) / 2;
+                if (values[2 * mid] <= val) lo = mid + 1;
+                else                        hi = mid;
+            }
+            return lo > 0 && uint32_t(val - values[2 * lo - 2]) <= values[2 * lo - 1];
+        }
+        }
+    }
+
+    // Return false if val was already there
+    bool add(uint16_t val) {
+        if (type == Run) {
+            if (contains(val)) return false;
+            decodeRuns();
+        }
+        if (type == Array) {
+            auto iter = lower_bound(values.begin(), values.end(), val);
+            if (iter != values.end() && *iter == val) return false;
+            if (card < ARRAY_MAX) {
+                values.insert(iter, val);
+                ++card;
+                return true;
+            }
+            toBitmap();
+        }
+        auto& word = words[val / 64];
+        auto  mask = uint64_t(1) << (val % 64);
+        if (word & mask) return false;
+        word |= mask;
+        ++card;
+        return true;
+    }
+
+    // Return false if val was not there
+    bool remove(uint16_t val) {
+        if (!contains(val)) return false;
+        if (type == Run) decodeRuns();
+        if (type == Array) {
+            values.erase(lower_bound(values.begin(), values.end(), val));
+        } else {
+            words[val / 64] &= ~(uint64_t(1) << (val % 64));
+        }
+        --card;
+        normalize();
+        return true;
+    }
+
+    // Calls func(base | val) for each value in ascending order
+    template<typename Func>
+    void for_each(Func func, uint32_t base = 0) const {
+        switch (type) {
+        case Array:
+            for (auto val : values) func(base | val);
+            break;
+        case Bitmap:
+            for (size_t w = 0; w < NUM_WORDS; ++w) {
+                for (auto word = words[w]; word; word &= word - 1) {
+                    func(base | uint32_t(w * 64 + ctz(word)));
+                }
+            }
+            break;
+        default:
+            for (size_t r = 0; r < values.size(); r += 2) {
+                uint32_t first = values[r], last = first + values[r + 1];
+                for (auto val = first; val <= last; ++val) func(base | val);
+            }
+        }
+    }
+
+    // Write the content as NUM_WORDS words
+    void fillWords(uint64_t* out) const {
+        if (type == Bitmap) {
+            copy(words.begin(), words.end(), out);
+            return;
+        }
+        fill(out, out + NUM_WORDS, uint64_t(0));
+        if (type == Array) {
+            for (auto val : values) out[val / 64] |= uint64_t(1) << (val % 64);
+        } else {
+            for (size_t r = 0; r < values.size(); r += 2) {
+                setBitRange(out, values[r], uint32_t(values[r]) + values[r + 1]);
+            }
+        }
+    }
+
+    void toBitmap() {
+        vector<uint64_t> bits(NUM_WORDS);
+        fillWords(bits.data());
+        words.swap(bits);
+        vector<uint16_t>().swap(values);
+        type = Bitmap;
+    }
+
+    void toArray() {
+        vector<uint16_t> vals;
+        vals.reserve(card);
+        for_each([&vals](uint32_t val) { vals.push_back(static_cast<uint16_t>(val)); });
+        values.swap(vals);
+        vector<uint64_t>().swap(words);
+        type = Array;
+    }
+
+    void toRuns() {
+        vector<uint16_t> runs;
+        runs.reserve(2 * countRuns());
+        uint32_t first = 0, last = 0;
+        bool open = false;
+        for_each([&](uint32_t val) {
+            if (open && val == last + 1) {
+                last = val;
+                return;
+            }
+            if (open) runs.insert(runs.end(), {uint16_t(first), uint16_t(last - first)});
+            first = last = val;
+            open  = true;
+        });
+        if (open) runs.insert(runs.end(), {uint16_t(first), uint16_t(last - first)});
+        values.swap(runs);
+        vector<uint64_t>().swap(words);
+        type = Run;
+    }
+
+    // Pick array or bitmap by cardinality, runs are kept
+    void normalize() {
+        if (type == Bitmap && card <= ARRAY_MAX) toArray();
+        else if (type == Array && card > ARRAY_MAX) toBitmap();
+    }
+
+    void decodeRuns() {
+        if (type != Run) return;
+        if (card <= ARRAY_MAX) toArray();
+        else                   toBitmap();
+    }
+
+    size_t countRuns() const {
+        size_t runs = 0;
+        switch (type) {
+        case Array:
+            for (size_t i = 0; i < values.size(); ++i) {
+                runs += i == 0 || values[i] != values[i - 1] + 1;
+            }
+            break;
+        case Bitmap: {
+            uint64_t carry = 0;
+            for (auto word : words) {
+                runs += popcount(word & ~((word << 1) | carry));
+                carry = word >> 63;
+            }
+            break;
+        }
+        default:
+            runs = values.size() / 2;
+        }
+        return runs;
+    }
+
+    // Switch to runs when they are the smallest encoding, return true if runs are used
+    bool runOptimize() {
+        auto run_bytes   = 2 + 4 * countRuns();
+        auto plain_bytes = card <= ARRAY_MAX ? 2 * size_t(card) : NUM_WORDS * 8;
+        if (run_bytes < plain_bytes) {
+            if (type != Run) toRuns();
+            return true;
+        }
+        decodeRuns();
+        return false;
+    }
+
+    size_t memory_usage() const {
+        return sizeof(*this) + values.capacity() * sizeof(uint16_t) +
+               words.capacity() * sizeof(uint64_t);
+    }
+
+    static RoaringContainer combine(const RoaringContainer& left, const RoaringContainer& right,
+                                    RoaringOp op) {
+        // Intersections and differences of an array only filter the array
+        if (op == RoaringOp::And && left.type == Array)  return filter(left, right, true);
+        if (op == RoaringOp::And && right.type == Array) return filter(right, left, true);
+        if (op == RoaringOp::AndNot && left.type == Array) return filter(left, right, false);
+
+        RoaringContainer result;
+        if (left.type == Array && right.type == Array) {
+            auto out = back_inserter(result.values);
+            result.values.reserve(left.values.size() + right.values.size());
+            if (op == RoaringOp::Or) {
+                set_union(left.values.begin(), left.values.end(),
+                          right.values.begin(), right.values.end(), out);
+            } else {
+                set_symmetric_difference(left.values.begin(), left.values.end(),
+                                         right.values.begin(), right.values.end(), out);
+            }
+            result.card = static_cast<uint32_t>(result.values.size());
+            result.normalize();
+            return result;
+        }
+
+        // Everything else goes through the word kernels
+        result.type = Bitmap;
+        result.words.resize(NUM_WORDS);
+        left.fillWords(result.words.data());
+        uint64_t buffer[NUM_WORDS];
+        const uint64_t* other = right.words.data();
+        if (right.type != Bitmap) {
+            right.fillWords(buffer);
+            other = buffer;
+        }
+        auto dst = result.words.data();
+        switch (op) {
+        case RoaringOp::And:    andWords(dst, other, NUM_WORDS);    break;
+        case RoaringOp::Or:     orWords(dst, other, NUM_WORDS);     break;
+        case RoaringOp::Xor:    xorWords(dst, other, NUM_WORDS);    break;
+        case RoaringOp::AndNot: andNotWords(dst, other, NUM_WORDS); break;
+        }
+        result.card = static_cast<uint32_t>(popcount(dst, NUM_WORDS));
+        result.normalize();
+        return result;
+    }
+
+    static RoaringContainer filter(const RoaringContainer& array, const RoaringContainer& other,
+                                   bool keep_common) {
+        RoaringContainer result;
+        for (auto val : array.values) {
+            if (other.contains(val) == keep_common) result.values.push_back(val);
+        }
+        result.card = static_cast<uint32_t>(result.values.size());
+        return result;
+    }
+
+    friend bool operator==(const RoaringContainer& left, const RoaringContainer& right) {
+        if (left.card != right.card) return false;
+        if (left.type == right.type) {
+            return left.type == Bitmap ? left.words == right.words : left.values == right.values;
+        }
+        uint64_t left_words[NUM_WORDS], right_words[NUM_WORDS];
+        left.fillWords(left_words);
+        right.fillWords(right_words);
+        return equal(left_words, left_words + NUM_WORDS, right_words);
+    }
+};
+} // End namespace detail
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Read-only access to a bitmap in the portable Roaring format (the one of CRoaring and
+// the Java library) without decoding it, e.g. straight from a memory-mapped file.
+// The data must outlive the view.
+class RoaringView {
+    static const uint32_t COOKIE_NO_RUN = 12346;
+    static const uint32_t COOKIE_RUN    = 12347;
+
+public:
+    RoaringView() : ptr(nullptr), len(0), num(0), run_flags(nullptr), header(nullptr),
+                    is_valid(false) {}
+
+    explicit RoaringView(ByteView data) : RoaringView() {
+        ptr = data.data();
+        len = data.size();
+        is_valid = parse();
+    }
+
+    bool valid() const { return is_valid; }
+
+    // Number of containers
+    size_t size() const { return num; }
+
+    // Bytes used by the serialized bitmap, data may continue after it
+    size_t bytes() const { return end_offset; }
+
+    uint64_t cardinality() const {
+        uint64_t result = 0;
+        for (size_t i = 0; i < num; ++i) result += card(i);
+        return result;
+    }
+
+    bool contains(uint32_t val) const {
+        uint16_t high = val >> 16, low = val & 0xFFFF;
+        size_t lo = 0, hi = num;
+        while (lo < hi) {
+            auto mid = (lo + hi) / 2;
+            if (key(mid) < high) lo = mid + 1;
+            else                 hi = mid;
+        }
+        if (lo == num || key(lo) != high) return false;
+
+        auto data = ptr + offsets[lo];
+        switch (type(lo)) {
+        case detail::RoaringContainer::Array: {
+            size_t first = 0, last = card(lo);
+            while (first < last) {
+                auto mid = (first + last) / 2;
+                if (loadLE<uint16_t>(data + 2 * mid) < low) first = mid + 1;
+                else                                      last  = mid;
+            }
+            return first < card(lo) && loadLE<uint16_t>(data + 2 * first) == low;
+        }
+        case detail::RoaringContainer::Bitmap:
+            return (loadLE<uint64_t>(data + 8 * (low / 64)) >> (low % 64)) & 1;
+        default: {
+            size_t first = 0, last = loadLE<uint16_t>(data);
+            while (first < last) {
+                auto mid = (first + last) / 2;
+                if (loadLE<uint16_t>(data + 2 + 4 * mid) <= low) first = mid + 1;
+                else                                          last  = mid;
+            }
+            if (first == 0) return false;
+            auto start = loadLE<uint16_t>(data + 4 * first - 2);
+            return uint32_t(low - start) <= loadLE<uint16_t>(data + 4 * first);
+        }
+        }
+    }
+
+    // Container access, container i holds the values key(i) << 16 | low
+    uint16_t key(size_t i) const  { return loadLE<uint16_t>(header + 4 * i); }
+    uint32_t card(size_t i) const { return loadLE<uint16_t>(header + 4 * i + 2) + 1u; }
+
+    detail::RoaringContainer::Type type(size_t i) const {
+        if (run_flags && ((run_flags[i / 8] >> (i % 8)) & 1)) return detail::RoaringContainer::Run;
+        return card(i) <= detail::RoaringContainer::ARRAY_MAX ? detail::RoaringContainer::Array
+                                                              : detail::RoaringContainer::Bitmap;
+    }
+
+    // Serialized container body, little endian uint16 values, uint64 words, or a uint16
+    // run count followed by (start, length - 1) pairs
+    const char* container(size_t i) const { return ptr + offsets[i]; }
+
+private:
+    bool parse() {
+        if (len < 4) return false;
+        auto cookie = loadLE<uint32_t>(ptr);
+        size_t pos = 4;
+        bool has_offsets = true;
+        if ((cookie & 0xFFFF) == COOKIE_RUN) {
+            num       = (cookie >> 16) + 1;
+            run_flags = reinterpret_cast<const uchar*>(ptr + pos);
+            pos      += (num + 7) / 8;
+            has_offsets = num >= 4;
+        } else if (cookie == COOKIE_NO_RUN) {
+            if (len < 8) return false;
+            num  = loadLE<uint32_t>(ptr + 4);
+            pos += 4;
+        } else {
+            return false;
+        }
+        if (num > 65536 || len < pos + 4 * num) return false;
+        header = ptr + pos;
+        pos   += 4 * num;
+        if (has_offsets && len < pos + 4 * num) return false;
+
+        offsets.resize(num);
+        end_offset = has_offsets ? pos + 4 * num : pos;
+        for (size_t i = 0; i < num; ++i) {
+            if (i > 0 && key(i) <= key(i - 1)) return false;
+            if (has_offsets) offsets[i] = loadLE<uint32_t>(ptr + pos + 4 * i);
+            else             offsets[i] = static_cast<uint32_t>(end_offset);
+
+            size_t body = 0;
+            auto   off  = offsets[i];
+            switch (type(i)) {
+            case detail::RoaringContainer::Array:  body = 2 * size_t(card(i)); break;
+            case detail::RoaringContainer::Bitmap: body = 8 * detail::RoaringContainer::NUM_WORDS; break;
+            default:
+                if (len < size_t(off) + 2) return false;
+                body = 2 + 4 * size_t(loadLE<uint16_t>(ptr + off));
+            }
+            if (len < size_t(off) + body) return false;
+            end_offset = max(end_offset, size_t(off) + body);
+        }
+        return true;
+    }
+
+    const char*  ptr;
+    size_t       len;
+    size_t       num;
+    const uchar* run_flags;
+    const char*  header;
+    vector<uint32_t> offsets;
+    size_t       end_offset = 0;
+    bool         is_valid;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Compressed bitmap of 32-bit values (Roaring). Values are split by their high 16 bits
+// into containers holding a sorted array (up to 4096 values), a 65536-bit bitmap or,
+// after runOptimize(), runs. Containers are never empty.
+class RoaringBitmap {
+    using Container = detail::RoaringContainer;
+
+public:
+    using value_type = uint32_t;
+
+    // Forward iterator over the values in ascending order
+    class const_iterator {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type        = uint32_t;
+        using difference_type   = ptrdiff_t;
+        using pointer           = const uint32_t*;
+        using reference         = uint32_t;
+
+        const_iterator() : owner(nullptr), ci(0), pos(0), word(0), val(0) {}
+        const_iterator(const RoaringBitmap* owner, size_t ci)
+            : owner(owner), ci(ci), pos(0), word(0), val(0) {
+            load();
+        }
+
+        uint32_t operator*() const { return val; }
+
+        const_iterator& operator++() {
+            auto& cont = owner->containers[ci];
+            uint32_t base = uint32_t(owner->keys[ci]) << 16;
+            switch (cont.type) {
+            case Container::Array:
+                if (++pos < cont.values.size()) return val = base | cont.values[pos], *this;
+                break;
+            case Container::Bitmap:
+                word &= word - 1;
+                while (!word && ++pos < Container::NUM_WORDS) word = cont.words[pos];
+                if (word) return val = base | uint32_t(pos * 64 + ctz(word)), *this;
+                break;
+            default:
+                if ((val & 0xFFFF) < uint32_t(cont.values[pos]) + cont.values[pos + 1]) {
+                    return ++val, *this;
+                }
+                if ((pos += 2) < cont.values.size()) return val = base | cont.values[pos], *this;
+            }
+            ++ci;
+            load();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto old = *this;
+            ++(*this);
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return ci == other.ci && val == other.val;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        // Move to the first value of container ci
+        void load() {
+            pos = 0;
+            val = 0;
+            if (ci >= owner->containers.size()) return;
+            auto& cont = owner->containers[ci];
+            uint32_t base = uint32_t(owner->keys[ci]) << 16;
+            if (cont.type == Container::Bitmap) {
+                while (!(word = cont.words[pos])) ++pos;
+                val = base | uint32_t(pos * 64 + ctz(word));
+            } else {
+                val = base | cont.values[0];
+            }
+        }
+
+        const RoaringBitmap* owner;
+        size_t   ci;
+        size_t   pos;
+        uint64_t word;
+        uint32_t val;
+    };
+
+    using iterator = const_iterator;
+
+    RoaringBitmap() = default;
+
+    RoaringBitmap(initializer_list<uint32_t> init) {
+        for (auto val : init) add(val);
+    }
+
+    // Set indices of a DynBitset, which must have less than 2^32 bits
+    explicit RoaringBitmap(const DynBitset& bits) {
+        bits.for_each_set([this](size_t idx) {
+            appendSorted(static_cast<uint32_t>(idx));
+        });
+    }
+
+    // Values below n as a DynBitset of size n
+    DynBitset toDynBitset(size_t n) const {
+        DynBitset result(n);
+        for_each([&result, n](uint32_t val) {
+            if (val < n) result[val] = true;
+        });
+        return result;
+    }
+
+    void add(uint32_t val) {
+        auto idx = findKey(val >> 16);
+        if (idx == keys.size() || keys[idx] != val >> 16) {
+            keys.insert(keys.begin() + idx, static_cast<uint16_t>(val >> 16));
+            containers.insert(containers.begin() + idx, Container());
+        }
+        containers[idx].add(val & 0xFFFF);
+    }
+
+    // Add all values in [first, last)
+    void addRange(uint64_t first, uint64_t last) {
+        last = min<uint64_t>(last, uint64_t(1) << 32);
+        while (first < last) {
+            auto high      = static_cast<uint16_t>(first >> 16);
+            auto chunk_end = min<uint64_t>(last, (uint64_t(high) + 1) << 16);
+            auto range     = Container::range(first & 0xFFFF, (chunk_end - 1) & 0xFFFF);
+            auto idx       = findKey(high);
+            if (idx < keys.size() && keys[idx] == high) {
+                containers[idx] = Container::combine(containers[idx], range, RoaringOp::Or);
+            } else {
+                keys.insert(keys.begin() + idx, high);
+                containers.insert(containers.begin() + idx, move(range));
+            }
+            first = chunk_end;
+        }
+    }
+
+    bool remove(uint32_t val) {
+        auto idx = findKey(val >> 16);
+        if (idx == keys.size() || keys[idx] != val >> 16) return false;
+        if (!containers[idx].remove(val & 0xFFFF)) return false;
+        if (containers[idx].card == 0) {
+            keys.erase(keys.begin() + idx);
+            containers.erase(containers.begin() + idx);
+        }
+        return true;
+    }
+
+    bool contains(uint32_t val) const {
+        auto idx = findKey(val >> 16);
+        return idx < keys.size() && keys[idx] == val >> 16 && containers[idx].contains(val & 0xFFFF);
+    }
+
+    uint64_t cardinality() const {
+        uint64_t result = 0;
+        for (auto& cont : containers) result += cont.card;
+        return result;
+    }
+
+    bool empty() const { return keys.empty(); }
+
+    void clear() {
+        keys.clear();
+        containers.clear();
+    }
+
+    // Convert containers to runs where that is smaller, return true if any uses runs
+    bool runOptimize() {
+        bool has_runs = false;
+        for (auto& cont : containers) has_runs |= cont.runOptimize();
+        return has_runs;
+    }
+
+    // Calls func(val) for each value in ascending order
+    template<typename Func>
+    void for_each(Func func) const {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            containers[i].for_each(func, uint32_t(keys[i]) << 16);
+        }
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const   { return const_iterator(this, keys.size()); }
+
+    RoaringBitmap& operator&=(const RoaringBitmap& other) { return *this = combine(*this, other, RoaringOp::And); }
+    RoaringBitmap& operator|=(const RoaringBitmap& other) { return *this = combine(*this, other, RoaringOp::Or); }
+    RoaringBitmap& operator^=(const RoaringBitmap& other) { return *this = combine(*this, other, RoaringOp::Xor); }
+
+    // *this &= ~other
+    RoaringBitmap& andNot(const RoaringBitmap& other) {
+        return *this = combine(*this, other, RoaringOp::AndNot);
+    }
+
+    static RoaringBitmap combine(const RoaringBitmap& left, const RoaringBitmap& right, RoaringOp op) {
+        bool keep_left  = op != RoaringOp::And;
+        bool keep_right = op == RoaringOp::Or || op == RoaringOp::Xor;
+        RoaringBitmap result;
+        size_t i = 0, j = 0;
+        while (i < left.keys.size() || j < right.keys.size()) {
+            if (j == right.keys.size() || (i < left.keys.size() && left.keys[i] < right.keys[j])) {
+                if (keep_left) result.push(left.keys[i], left.containers[i]);
+                ++i;
+            } else if (i == left.keys.size() || right.keys[j] < left.keys[i]) {
+                if (keep_right) result.push(right.keys[j], right.containers[j]);
+                ++j;
+            } else {
+                auto cont = Container::combine(left.containers[i], right.containers[j], op);
+                if (cont.card) result.push(left.keys[i], move(cont));
+                ++i, ++j;
+            }
+        }
+        return result;
+    }
+
+    friend bool operator==(const RoaringBitmap& left, const RoaringBitmap& right) {
+        return left.keys == right.keys && left.containers == right.containers;
+    }
+
+    // Bytes used in memory
+    size_t memory_usage() const {
+        size_t result = sizeof(*this) + keys.capacity() * sizeof(uint16_t);
+        for (auto& cont : containers) result += cont.memory_usage();
+        return result;
+    }
+
+    // Serialization in the portable Roaring format, see RoaringView
+    ByteArray toByteArray() const {
+        bool has_runs = any_of(containers.begin(), containers.end(), [](const Container& cont) {
+            return cont.type == Container::Run;
+        });
+        auto num = keys.size();
+        ByteArray result;
+        ByteWriter writer(result, serializedSize());
+        if (has_runs) {
+            writer.putLE<uint32_t>(12347 | uint32_t(num - 1) << 16);
+            vector<uchar> run_flags((num + 7) / 8);
+            for (size_t i = 0; i < num; ++i) {
+                if (containers[i].type == Container::Run) run_flags[i / 8] |= uchar(1 << (i % 8));
+            }
+            writer.putSpan(run_flags);
+        } else {
+            writer.putLE<uint32_t>(12346).putLE<uint32_t>(static_cast<uint32_t>(num));
+        }
+        for (size_t i = 0; i < num; ++i) {
+            writer.putLE(keys[i]).putLE(static_cast<uint16_t>(containers[i].card - 1));
+        }
+        if (!has_runs || num >= 4) {
+            auto offset = writer.size() + 4 * num;
+            for (auto& cont : containers) {
+                writer.putLE(static_cast<uint32_t>(offset));
+                offset += bodySize(cont);
+            }
+        }
+        for (auto& cont : containers) {
+            if (cont.type == Container::Run) {
+                writer.putLE(static_cast<uint16_t>(cont.values.size() / 2));
+                for (auto val : cont.values) writer.putLE(val);
+            } else if (cont.card <= Container::ARRAY_MAX) {
+                cont.for_each([&writer](uint32_t val) { writer.putLE(static_cast<uint16_t>(val)); });
+            } else {
+                uint64_t words[Container::NUM_WORDS];
+                cont.fillWords(words);
+                for (auto word : words) writer.putLE(word);
+            }
+        }
+        writer.flush();
+        return result;
+    }
+
+    size_t serializedSize() const {
+        bool has_runs = false;
+        size_t result = 0;
+        for (auto& cont : containers) {
+            has_runs |= cont.type == Container::Run;
+            result   += 4 + bodySize(cont);
+        }
+        auto num = keys.size();
+        if (has_runs) result += 4 + (num + 7) / 8 + (num >= 4 ? 4 * num : 0);
+        else          result += 8 + 4 * num;
+        return result;
+    }
+
+    // Decode and validate, false and empty on malformed data
+    bool fromByteArray(ByteView data) {
+        clear();
+        RoaringView view(data);
+        if (!view.valid()) return false;
+        keys.reserve(view.size());
+        containers.reserve(view.size());
+        for (size_t i = 0; i < view.size(); ++i) {
+            Container cont;
+            cont.type = view.type(i);
+            cont.card = view.card(i);
+            auto body = view.container(i);
+            bool ok   = true;
+            if (cont.type == Container::Array) {
+                cont.values.resize(cont.card);
+                for (size_t k = 0; k < cont.card; ++k) {
+                    cont.values[k] = loadLE<uint16_t>(body + 2 * k);
+                    ok &= k == 0 || cont.values[k] > cont.values[k - 1];
+                }
+            } else if (cont.type == Container::Bitmap) {
+                cont.words.resize(Container::NUM_WORDS);
+                for (size_t k = 0; k < Container::NUM_WORDS; ++k) {
+                    cont.words[k] = loadLE<uint64_t>(body + 8 * k);
+                }
+                ok = popcount(cont.words.data(), Container::NUM_WORDS) == cont.card;
+            } else {
+                cont.values.resize(2 * size_t(loadLE<uint16_t>(body)));
+                uint32_t total = 0, next = 0;
+                for (size_t k = 0; k < cont.values.size(); k += 2) {
+                    cont.values[k]     = loadLE<uint16_t>(body + 2 + 2 * k);
+                    cont.values[k + 1] = loadLE<uint16_t>(body + 4 + 2 * k);
+                    auto last = uint32_t(cont.values[k]) + cont.values[k + 1];
+                    ok &= cont.values[k] >= next && last < 65536;
+                    next   = last + 2;
+                    total += cont.values[k + 1] + 1;
+                }
+                ok &= !cont.values.empty() && total == cont.card;
+            }
+            if (!ok) return clear(), false;
+            push(view.key(i), move(cont));
+        }
+        return true;
+    }
+
+private:
+    size_t findKey(uint32_t high) const {
+        return lower_bound(keys.begin(), keys.end(), high) - keys.begin();
+    }
+
+    void push(uint16_t key, Container cont) {
+        keys.push_back(key);
+        containers.push_back(move(cont));
+    }
+
+    // Append a value larger than all present ones
+    void appendSorted(uint32_t val) {
+        auto high = static_cast<uint16_t>(val >> 16);
+        if (keys.empty() || keys.back() != high) push(high, Container());
+        auto& cont = containers.back();
+        if (cont.type == Container::Array && cont.card < Container::ARRAY_MAX) {
+            cont.values.push_back(static_cast<uint16_t>(val));
+            ++cont.card;
+        } else {
+            cont.add(val & 0xFFFF);
+        }
+    }
+
+    static size_t bodySize(const Container& cont) {
+        if (cont.type == Container::Run) return 2 + 2 * cont.values.size();
+        return cont.card <= Container::ARRAY_MAX ? 2 * size_t(cont.card) : 8 * Container::NUM_WORDS;
+    }
+
+    vector<uint16_t>  keys;
+    vector<Container> containers;
+};
+
+inline RoaringBitmap operator&(const RoaringBitmap& left, const RoaringBitmap& right)
+{
+    return RoaringBitmap::combine(left, right, RoaringOp::And);
+}
+
+inline RoaringBitmap operator|(const RoaringBitmap& left, const RoaringBitmap& right)
+{
+    return RoaringBitmap::combine(left, right, RoaringOp::Or);
+}
+
+inline RoaringBitmap operator^(const RoaringBitmap& left, const RoaringBitmap& right)
+{
+    return RoaringBitmap::combine(left, right, RoaringOp::Xor);
+}
+
+// left & ~right
+inline RoaringBitmap andNot(const RoaringBitmap& left, const RoaringBitmap& right)
+{
+    return RoaringBitmap::combine(left, right, RoaringOp::AndNot);
+}
+
+inline bool operator!=(const RoaringBitmap& left, const RoaringBitmap& right)
+{
+    return !(left == right);
+}
+_CLS_END
+
+#endif // CLS_ROARING_HPP
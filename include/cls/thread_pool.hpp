@@ -0,0 +1,218 @@
+/////////////////////////////////////////////////////////////////////////////////
+// The MIT License(MIT)
+//
+// Copyright (c) 2015 by Tiangang Song
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+/////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLS_THREAD_POOL_HPP
+#define CLS_THREAD_POOL_HPP
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include "cls_defs.h"
+
+_CLS_BEGIN
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t num_threads = thread::hardware_concurrency())
+        : stopped(false) {
+        num_threads = max<size_t>(num_threads, 1);
+        for (size_t i = 0; i < num_threads; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Finish all queued tasks before joining the workers
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            stopped = true;
+        }
+        cond.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    template<typename Func, typename... Args>
+    auto submit(Func&& func, Args&&... args) -> future<typename result_of<Func(Args...)>::type> {
+        using Result = typename result_of<Func(Args...)>::type;
+
+        auto task = make_shared<packaged_task<Result()>>(
+            bind(forward<Func>(func), forward<Args>(args)...));
+        auto result = task->get_future();
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            tasks.emplace([task] { (*task)(); });
+        }
+        cond.notify_one();
+
+        return result;
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // Process wide pool shared by the library's parallel algorithms
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(queue_mutex);
+                cond.wait(lock, [this] { return stopped || !tasks.empty(); });
+                if (stopped && tasks.empty()) return;
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex queue_mutex;
+    condition_variable cond;
+    bool stopped;
+};
+
+// Blocking multi-producer multi-consumer queue. With a capacity push() waits for room,
+// which holds back producers that run ahead of the consumers. After close() pushes are
+// ignored and pop() returns false once the queue is drained.
+template<typename T>
+class ConcurrentQueue {
+public:
+    explicit ConcurrentQueue(size_t capacity = 0) : cap(capacity), is_closed(false) {}
+
+    ConcurrentQueue(const ConcurrentQueue&) = delete;
+    ConcurrentQueue& operator=(const ConcurrentQueue&) = delete;
+
+    bool push(T value) {
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            not_full.wait(lock, [this] { return is_closed || cap == 0 || items.size() < cap; });
+            if (is_closed) return false;
+            items.push(move(value));
+        }
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Wait for an item, false if the queue is closed and empty
+    bool pop(T& value) {
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            not_empty.wait(lock, [this] { return is_closed || !items.empty(); });
+            if (items.empty()) return false;
+            value = move(items.front());
+            items.pop();
+        }
+        not_full.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            if (items.empty()) return false;
+            value = move(items.front());
+            items.pop();
+        }
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            is_closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    bool closed() const {
+        lock_guard<mutex> lock(queue_mutex);
+        return is_closed;
+    }
+
+    size_t size() const {
+        lock_guard<mutex> lock(queue_mutex);
+        return items.size();
+    }
+
+private:
+    queue<T> items;
+    size_t cap;
+    bool is_closed;
+    mutable mutex queue_mutex;
+    condition_variable not_empty;
+    condition_variable not_full;
+};
+
+// Wait for every task of the batch. Call it before the first get() that may rethrow, the
+// remaining tasks could still use state of the caller that unwinding destroys.
+template<typename T>
+inline void waitAll(vector<future<T>>& results)
+{
+    for (auto& result : results) {
+        if (result.valid()) result.wait();
+    }
+}
+
+// Call func(idx) for every idx in [first, last), split into one chunk per worker.
+// Must not be called from a task running on the same pool.
+template<typename Func>
+void parallelFor(size_t first, size_t last, Func func, ThreadPool& pool = ThreadPool::instance())
+{
+    if (first >= last) return;
+
+    auto chunks     = min(pool.size(), last - first);
+    auto chunk_size = (last - first + chunks - 1) / chunks;
+
+    vector<future<void>> results;
+    for (auto begin = first; begin < last; begin += chunk_size) {
+        auto end = min(begin + chunk_size, last);
+        results.push_back(pool.submit([begin, end, &func] {
+            for (auto idx = begin; idx < end; ++idx) func(idx);
+        }));
+    }
+    waitAll(results);
+    for (auto& result : results) {
+        result.get();
+    }
+}
+_CLS_END
+
+#endif // CLS_THREAD_POOL_HPP
@@ -1,9 +1,26 @@
 #include <iostream>
 #include <forward_list>
 #include <random>
+#include <bitset>
 #include <cls/utilities.h>
 #include <cls/algorithm.hpp>
 #include <cls/dyn_bitset.hpp>
+#include <cls/hash.hpp>
+#include <cls/compress.hpp>
+#include <cls/byte_io.hpp>
+#include <cls/chunker.hpp>
+#include <cls/rank_select.hpp>
+#include <cls/roaring.hpp>
+#include <cls/atomic_bitset.hpp>
+#include <cls/bloom.hpp>
+#include <cls/bit_io.hpp>
+#include <cls/mapped_bitset.hpp>
+#include <cls/line_index.hpp>
+#include <cls/record_reader.hpp>
+#include <cls/async_io.hpp>
+#include <cls/dir_walk.hpp>
+#include <cls/csv.hpp>
+#include <cls/file_cache.hpp>
 
 using namespace std;
 using namespace cls;
@@ -164,6 +181,501 @@ void algTest()
     DBGVAR(cout, *minmax_val.second);
 }
 
+void hashTest()
+{
+    ByteArray digits("123456789");
+    CLS_Assert(0xE3069283u == crc32c(digits));
+    CLS_Assert(0xE3069283u == crc32c(digits.data() + 4, 5, crc32c(digits.data(), 4)));
+
+    CLS_Assert(0xEF46DB3751D8E999ULL == hash64("", 0));
+    CLS_Assert(0x44BC2CF5AD770999ULL == hash64("abc", 3));
+
+    ByteArray data(1000);
+    iota(data.begin(), data.end(), 0);
+    Hash64 hasher;
+    for (auto pos = 0u; pos < data.size(); pos += 77) {
+        hasher.update(data.data() + pos, min<size_t>(77, data.size() - pos));
+    }
+    CLS_Assert(hash64(data) == hasher.digest());
+    CLS_Assert(hash<ByteArray>()(data) == hash<ByteArray>()(ByteArray(data)));
+    CLS_Assert(hash<DynBitset>()(DynBitset(12, "100110111010")) ==
+               hash<DynBitset>()(DynBitset(12, "100110111010")));
+}
+
+void compressTest()
+{
+    ByteArray data;
+    for (int i = 0; i < 20000; ++i) {
+        data += to_string(i % 777) + ",";
+    }
+
+    auto block = lzCompress(data, 2);
+    CLS_Assert(block.size() < data.size());
+    CLS_Assert(lzDecompress(block, data.size()) == data);
+
+    LzOptions opts;
+    opts.block_log = 16;
+    ThreadPool pool(2);
+    auto frame = lzCompressFrame(data, opts, &pool);
+    CLS_Assert(lzDecompressFrame(frame) == data);
+
+    // A corrupt block throws only after the other blocks are done with the output
+    auto corrupt = frame;
+    fill(corrupt.begin() + 16, corrupt.begin() + 64, char(0xff));
+    bool corrupt_thrown = false;
+    try {
+        lzDecompressFrame(corrupt, &pool);
+    } catch (const exception&) {
+        corrupt_thrown = true;
+    }
+    CLS_Assert(corrupt_thrown);
+
+    ByteArray decoded;
+    LzFrameDecoder decoder;
+    for (size_t pos = 0; pos < frame.size(); pos += 1000) {
+        decoder.write(ByteView(frame).sub(pos, 1000), decoded);
+    }
+    CLS_Assert(decoder.finished() && decoded == data);
+    CLS_Assert(ByteView(frame).sub(frame.size() + 10, 5).empty());
+}
+
+void byteIOTest()
+{
+    ByteArray data;
+    {
+        ByteWriter writer(data, 64);
+        writer.putBE<uint32_t>(0x01020304).putLE<uint16_t>(0x0506).putLE(-1.5);
+        writer.putVarint(300).putZigzag(-3).putVarint(~0ULL);
+        int values[] = {7, 8, 9};
+        writer.putSpan(values, 3);
+    }
+    CLS_Assert(data[0] == 1 && data[3] == 4 && data[4] == 6);
+
+    ByteReader reader(data);
+    CLS_Assert(reader.getBE<uint32_t>() == 0x01020304);
+    CLS_Assert(reader.getLE<uint16_t>() == 0x0506);
+    CLS_Assert(reader.getLE<double>() == -1.5);
+    CLS_Assert(reader.getVarint() == 300 && reader.getZigzag() == -3);
+    CLS_Assert(reader.getVarint() == ~0ULL);
+    int values[3];
+    CLS_Assert(reader.getSpan(values, 3) && values[2] == 9 && reader.atEnd());
+
+    CLS_Assert(reader.getLE<uint32_t>() == 0 && !reader.ok());
+    CLS_Assert(reader.error() == ByteReader::Error::OutOfRange);
+
+    BasicByteArray<PageAlignedAllocator<char>> page_buf(10, 'x');
+    CLS_Assert(reinterpret_cast<uintptr_t>(page_buf.data()) % 4096 == 0);
+    memcpy(page_buf.reserve_for_write(5), "hello", 5);
+    CLS_Assert(page_buf.size() == 15 && page_buf.to_string().substr(8) == "xxhello");
+    page_buf.resize(20);
+    CLS_Assert(page_buf[19] == 0);
+
+    vector<uint16_t> samples(100);
+    iota(samples.begin(), samples.end(), uint16_t(0x0100));
+    auto big_endian = storeArrayBE(samples);
+    CLS_Assert(big_endian[0] == 1 && big_endian[1] == 0);
+    CLS_Assert(loadArrayBE<uint16_t>(big_endian) == samples);
+    byteswapInPlace(big_endian, 2);
+    CLS_Assert(loadArrayLE<uint16_t>(big_endian) == samples);
+}
+
+void chunkerTest()
+{
+    default_random_engine engine(7);
+    ByteArray data(1 << 20);
+    generate(data, [&engine] { return static_cast<char>(engine()); });
+
+    Chunker chunker;
+    ChunkIndex index;
+    size_t total = 0;
+    for (const auto& chunk : chunker.split(data)) {
+        CLS_Assert(chunk.size <= chunker.options().max_size);
+        CLS_Assert(chunk.offset == total);
+        total += chunk.size;
+        index.add(chunk, chunk.offset);
+    }
+    CLS_Assert(total == data.size());
+
+    // An insertion only disturbs the chunk it lands in
+    data.insert(data.begin() + 300000, 'x');
+    size_t new_chunks = 0;
+    for (const auto& chunk : chunker.split(data)) {
+        if (index.add(chunk, chunk.offset).second) ++new_chunks;
+    }
+    CLS_Assert(new_chunks <= 2);
+
+    ChunkIndex loaded;
+    CLS_Assert(loaded.fromByteArray(index.toByteArray()));
+    CLS_Assert(loaded.size() == index.size() && loaded.uniqueBytes() == index.uniqueBytes());
+}
+
+void bitsetTest()
+{
+    const string bits = "1011001110001111000011111000001111110000000111111100000000111111111";
+    bitset<67> expected(bits);
+    DynBitset dyn_bitset(bits.size(), bits);
+    BitField bit_field(bits.size(), bits);
+    for (size_t i = 0; i < bits.size(); ++i) {
+        CLS_Assert(dyn_bitset[i] == expected[i]);
+        CLS_Assert(bit_field[i] == (bits[i] == '1'));
+    }
+    CLS_Assert(dyn_bitset.count() == expected.count());
+    CLS_Assert(dyn_bitset.to_string() == bits);
+    CLS_Assert(DynBitset(bits.size(), dyn_bitset.toByteArray()) == dyn_bitset);
+
+    dyn_bitset.set();
+    CLS_Assert(dyn_bitset.all() && dyn_bitset.count() == bits.size());
+    dyn_bitset.reset(66);
+    CLS_Assert(!dyn_bitset.all() && dyn_bitset.any() && dyn_bitset.to_string()[0] == '0');
+    CLS_Assert(DynBitset(3, "010") < DynBitset(3, "011") && DynBitset(2, "01") < DynBitset(3, "010"));
+
+    // Growing keeps the string prefix
+    DynBitset grown;
+    for (auto c : bits) grown.push_back(c == '1');
+    CLS_Assert(grown == DynBitset(bits.size(), bits));
+    grown.append(DynBitset(3, "101"));
+    CLS_Assert(grown.to_string() == bits + "101");
+    grown.resize(bits.size() + 70, true);
+    CLS_Assert(grown.to_string() == bits + "101" + string(67, '1'));
+    grown.resize(5);
+    grown.shrink_to_fit();
+    CLS_Assert(grown.to_string() == bits.substr(0, 5) && grown.capacity() >= grown.size());
+
+    // Bitwise algebra and shifts
+    const string other = "0110101001011100111000111100001111100000111111000000111111100000001";
+    bitset<67> expected_other(other);
+    DynBitset lhs(bits.size(), bits), rhs(bits.size(), other);
+    CLS_Assert((lhs & rhs).to_string() == (expected & expected_other).to_string());
+    CLS_Assert((lhs | rhs).to_string() == (expected | expected_other).to_string());
+    CLS_Assert((lhs ^ rhs).to_string() == (expected ^ expected_other).to_string());
+    CLS_Assert(andNot(lhs, rhs).to_string() == (expected & ~expected_other).to_string());
+    CLS_Assert((~lhs).to_string() == (~expected).to_string());
+    CLS_Assert(countAnd(lhs, rhs) == (expected & expected_other).count());
+    CLS_Assert(countXor(lhs, rhs) == (expected ^ expected_other).count());
+    bool size_mismatch = false;
+    try {
+        countOr(lhs, DynBitset(lhs.size() + 64));
+    } catch (const invalid_argument&) {
+        size_mismatch = true;
+    }
+    CLS_Assert(size_mismatch);
+    for (size_t shift : {0, 1, 13, 64, 66, 67}) {
+        CLS_Assert((lhs << shift).to_string() == (expected << shift).to_string());
+        CLS_Assert((lhs >> shift).to_string() == (expected >> shift).to_string());
+    }
+
+    // Set bit iteration
+    vector<size_t> expected_idx, set_idx;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i]) expected_idx.push_back(i);
+    }
+    lhs.for_each_set([&set_idx](size_t i) { set_idx.push_back(i); });
+    CLS_Assert(set_idx == expected_idx);
+    set_idx.assign(lhs.set_bits().begin(), lhs.set_bits().end());
+    CLS_Assert(set_idx == expected_idx);
+    set_idx.clear();
+    for (auto i = lhs.find_first(); i != DynBitset::npos; i = lhs.find_next(i)) {
+        set_idx.push_back(i);
+    }
+    CLS_Assert(set_idx == expected_idx);
+    CLS_Assert(lhs.find_last() == expected_idx.back() && lhs.find_prev(expected_idx[1]) == expected_idx[0]);
+    CLS_Assert(bit_field.find_first() == 0 && bit_field.find_next(0) == 2 && bit_field.find_prev(2) == 0);
+
+    // Rank/select
+    DynBitset sparse(10000);
+    for (size_t i = 0; i < sparse.size(); i += 7) sparse[i] = true;
+    RankSelect rank_select(sparse);
+    CLS_Assert(rank_select.count() == sparse.count());
+    for (size_t i = 0; i <= sparse.size(); i += 13) {
+        CLS_Assert(rank_select.rank(i) == (i + 6) / 7);
+    }
+    for (size_t k = 0; k < rank_select.count(); k += 11) {
+        CLS_Assert(rank_select.select(k) == k * 7);
+    }
+    CLS_Assert(rank_select.select(rank_select.count()) == RankSelect::npos);
+
+    // Compressed bitmap
+    RoaringBitmap roaring(sparse);
+    CLS_Assert(roaring.cardinality() == sparse.count() && roaring.toDynBitset(sparse.size()) == sparse);
+    RoaringBitmap ranges;
+    ranges.addRange(5, 200000);
+    ranges.add(1u << 31);
+    CLS_Assert(ranges.cardinality() == 200000 - 5 + 1 && ranges.contains(70000) && !ranges.contains(4));
+    CLS_Assert((roaring & ranges).cardinality() == (10000 - 5 + 6) / 7);
+    CLS_Assert((roaring | ranges).cardinality() == ranges.cardinality() + 1);
+    CLS_Assert(andNot(roaring, ranges) == RoaringBitmap{0});
+    CLS_Assert((roaring ^ ranges).contains(0) && !(roaring ^ ranges).contains(7));
+    vector<uint32_t> values(roaring.begin(), roaring.end());
+    CLS_Assert(values.size() == roaring.cardinality() && values[1] == 7);
+    ranges.runOptimize();
+    auto serialized = ranges.toByteArray();
+    RoaringBitmap decoded;
+    CLS_Assert(decoded.fromByteArray(serialized) && decoded == ranges);
+    RoaringView view(serialized);
+    CLS_Assert(view.valid() && view.contains(1u << 31) && !view.contains(200000));
+    CLS_Assert(!decoded.fromByteArray(ByteView(serialized.data(), serialized.size() - 1)));
+
+    // Atomic bitset, each index is claimed by exactly one thread
+    AtomicBitset visited(100000);
+    atomic<size_t> claimed(0);
+    parallelFor(0, 4, [&](size_t) {
+        for (size_t i = 0; i < visited.size(); i += 3) {
+            if (!visited.test_and_set(i)) ++claimed;
+        }
+    });
+    CLS_Assert(claimed == (100000 + 2) / 3 && visited.count() == claimed);
+    CLS_Assert(visited.count(ThreadPool::instance()) == claimed && visited.toDynBitset().count() == claimed);
+    CLS_Assert(visited.test_and_reset(3) && !visited.test(3) && visited.test(6));
+
+    // Bloom filters, no false negatives and roughly the expected false positive rate
+    vector<uint64_t> key_hashes(20000);
+    for (size_t i = 0; i < key_hashes.size(); ++i) key_hashes[i] = hash64(&i, sizeof(i));
+    BloomFilter bloom(10000, 10);
+    BlockedBloomFilter blocked_bloom(10000, 10);
+    bloom.insertHashes(key_hashes.data(), 10000);
+    blocked_bloom.insertHashes(key_hashes.data(), 10000);
+    unique_ptr<bool[]> found(new bool[key_hashes.size()]);
+    CLS_Assert(bloom.mayContainHashes(key_hashes.data(), 10000, found.get()) == 10000);
+    CLS_Assert(blocked_bloom.mayContainHashes(key_hashes.data(), 10000, found.get()) == 10000);
+    CLS_Assert(bloom.mayContainHashes(key_hashes.data() + 10000, 10000, found.get()) < 200);
+    CLS_Assert(blocked_bloom.mayContainHashes(key_hashes.data() + 10000, 10000, found.get()) < 200);
+    bloom.insert(ByteView("key"));
+    BloomFilter loaded;
+    CLS_Assert(loaded.fromByteArray(bloom.toByteArray()) && loaded.mayContain(ByteView("key")));
+    CLS_Assert(!loaded.fromByteArray(blocked_bloom.toByteArray()));
+    CLS_Assert(!loaded.mayContain(ByteView("key")) && !BlockedBloomFilter().mayContainHash(key_hashes[0]));
+
+    // Bit streams
+    ByteArray bit_stream;
+    {
+        BitWriter writer(bit_stream);
+        writer.write_bits(0x5, 3).write_ue(0).write_ue(7).write_se(-3).align();
+        writer.write_bits(0x0123456789ABCDEF, 64).write_bit(true);
+        CLS_Assert(writer.size() == 16 + 64 + 1);
+    }
+    CLS_Assert(bit_stream.size() == 11 && uchar(bit_stream[0]) == 0xB1);
+    BitReader bit_reader(bit_stream);
+    CLS_Assert(bit_reader.read_bits(3) == 5 && bit_reader.read_ue() == 0 && bit_reader.read_ue() == 7);
+    CLS_Assert(bit_reader.read_se() == -3 && bit_reader.align() && bit_reader.position() == 16);
+    CLS_Assert(bit_reader.read_bits(64) == 0x0123456789ABCDEF && bit_reader.read_bit());
+    bit_reader.read_bits(8);
+    CLS_Assert(!bit_reader.ok());
+    BitField stream_bits(bit_stream.size() * 8, bit_stream);
+    BitReader field_reader(stream_bits);
+    CLS_Assert(field_reader.read_bits(3) == 5);
+
+    // File backed bitset, changes are visible after reopening
+    DynBitset disk_ref(1000);
+    for (size_t i = 0; i < 1000; i += 7) disk_ref.set(i);
+    {
+        auto mapped = MappedBitset::create("mapped_bitset_test.bits", disk_ref);
+        mapped.set(999).reset(0).flip(500);
+        mapped.flush();
+    }
+    disk_ref.set(999).reset(0).flip(500);
+    {
+        MappedBitset mapped("mapped_bitset_test.bits", false);
+        CLS_Assert(mapped.size() == 1000 && mapped.count() == disk_ref.count());
+        CLS_Assert(mapped.find_first() == 7 && mapped.find_next(7) == 14 && mapped.find_last() == 999);
+        CLS_Assert(mapped.find_prev(500) == disk_ref.find_prev(500) && mapped.toDynBitset() == disk_ref);
+        CLS_Assert(countAnd(mapped, disk_ref) == disk_ref.count());
+        bool read_only = false;
+        try {
+            mapped.set(1);
+        } catch (const FileExcept&) {
+            read_only = true;
+        }
+        CLS_Assert(read_only && !mapped.test(1));
+    }
+    remove("mapped_bitset_test.bits");
+}
+
+void fileTest()
+{
+    string text;
+    for (int i = 0; i < 1000; ++i) text += "line " + to_string(i) + "\n";
+    CLS_Assert(writeFile("file_test.txt", ByteView(text)));
+    CLS_Assert(readFile("file_test.txt") == text);
+    CLS_Assert(readBinaryFile("file_test.txt").to_string() == text);
+    auto aligned_data = readBinaryFile<AlignedAllocator<char, 4096>>("file_test.txt");
+    CLS_Assert(aligned_data.size() == text.size() && uintptr_t(aligned_data.data()) % 4096 == 0);
+    // Code written for the vector<char> results still compiles
+    vector<char> legacy_data = readBinaryFile("file_test.txt");
+    auto legacy_size = [](const vector<char>& data) { return data.size(); };
+    ByteArray legacy_bytes = legacy_data;
+    CLS_Assert(legacy_size(legacy_bytes) == text.size() && legacy_bytes.to_string() == text);
+
+    MappedFile mapped("file_test.txt");
+    mapped.advise(MappedFile::Advice::Sequential);
+    CLS_Assert(mapped.is_open() && !mapped.writable() && mapped.view() == ByteView(text));
+
+    // Line counting, an unterminated last line counts too
+    CLS_Assert(countLines("file_test.txt", &ThreadPool::instance()) == 1000);
+    CLS_Assert(countLines(ByteView("a\r\nb")) == 2 && countLines(ByteView("a\n\n")) == 2);
+    CLS_Assert(countLines(ByteView(string(10000, '\n') + "x"), &ThreadPool::instance()) == 10001);
+    CLS_Assert(countLine("file_test.missing") == 0 && countLine(".") == 0);
+
+    // Line index, the second one is loaded from the cache file
+    LineIndex lines("file_test.txt", "file_test.idx");
+    CLS_Assert(!lines.cached() && lines.size() == 1000 && int(lines.size()) == countLine("file_test.txt"));
+    CLS_Assert(lines[0] == ByteView("line 0") && lines.line(999) == ByteView("line 999"));
+    CLS_Assert(lines[500].to_string() == getLineStr("file_test.txt", 501) && lines.offset(1) == 7);
+    LineIndex cached_lines("file_test.txt", "file_test.idx");
+    CLS_Assert(cached_lines.cached() && cached_lines.size() == 1000 && cached_lines[123] == lines[123]);
+    auto idx_data = readBinaryFile("file_test.idx");
+    swap_ranges(idx_data.end() - 16, idx_data.end() - 8, idx_data.end() - 24);
+    writeFile("file_test.idx", ByteView(idx_data));
+    LineIndex corrupt_lines("file_test.txt", "file_test.idx");
+    CLS_Assert(!corrupt_lines.cached() && corrupt_lines[998] == lines[998]);
+
+    // Streaming records, the small buffer forces records across refills
+    LineReader line_reader("file_test.txt", 16);
+    size_t line_count = 0;
+    for (auto line : line_reader) {
+        if (line != lines[line_count++]) break;
+    }
+    CLS_Assert(line_count == 1000 && line_reader.records() == 1000);
+    string csv_line = "a,bb,,ccc";
+    RecordReader fields(ByteView(csv_line), ',');
+    CLS_Assert(count_if(fields, [](ByteView field) { return !field.empty(); }) == 3);
+
+    // Batched reads, through io_uring where available and on the pool
+    vector<ReadRequest> requests = {ReadRequest("file_test.txt"), ReadRequest("file_test.txt", 7, 6),
+                                    ReadRequest("file_test.txt", text.size() - 4, 100)};
+    for (bool use_uring : {true, false}) {
+        AsyncFileReader async_reader(8, nullptr, use_uring);
+        auto contents = async_reader.read(requests);
+        CLS_Assert(contents.size() == 3 && contents[0].to_string() == text);
+        CLS_Assert(contents[1].to_string() == "line 1" && contents[2].to_string() == "999\n");
+        int missing_error = 0;
+        async_reader.read({ReadRequest("file_test.missing")}, [&](size_t, ByteArray&&, int error) {
+            missing_error = error;
+        });
+        CLS_Assert(missing_error == ENOENT);
+
+        // A throwing callback leaves the reader usable
+        vector<ReadRequest> many(64, ReadRequest("file_test.txt"));
+        bool thrown = false;
+        try {
+            async_reader.read(vector<ReadRequest>(many), [](size_t, ByteArray&&, int) {
+                throw runtime_error("stop");
+            });
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        CLS_Assert(thrown && async_reader.read(many).back().to_string() == text);
+    }
+
+    // Directory walk, the test files are in the working directory
+    WalkOptions walk_opts;
+    walk_opts.max_depth  = 1;
+    walk_opts.extensions = {"TXT"};
+    walk_opts.patterns   = {"file_t?st.*"};
+    walk_opts.stat       = true;
+    auto walked = walkDirectory(".", walk_opts);
+    CLS_Assert(walked.size() == 1 && walked[0].name() == "file_test.txt" && walked[0].depth == 1);
+    CLS_Assert(walked[0].type == EntryType::File && walked[0].info.size == text.size());
+    walk_opts.pool = &ThreadPool::instance();
+    walk_opts.extensions.clear();
+    walk_opts.patterns = {"*"};
+    walk_opts.max_depth = 2;
+    ConcurrentQueue<DirEntry> walk_queue;
+    auto walk_count = walkDirectory(".", walk_opts, walk_queue);
+    DirEntry walk_entry;
+    size_t queued = 0;
+    while (walk_queue.pop(walk_entry)) ++queued;
+    CLS_Assert(walk_count == queued && walk_count >= 2);
+#ifndef _WIN32
+    WalkOptions root_opts;
+    root_opts.max_depth    = 1;
+    root_opts.include_dirs = true;
+    auto root_entries = walkDirectory("/", root_opts);
+    CLS_Assert(!root_entries.empty() && all_of(root_entries.begin(), root_entries.end(), [](const DirEntry& entry) {
+        return entry.path.compare(0, 2, "//") != 0 && entry.path[0] == '/';
+    }));
+#endif
+    CLS_Assert(globMatch("*.[ch]pp", "dir_walk.hpp") && !globMatch("[!d]*", "dir_walk.hpp"));
+
+    // Buffered and gathered writes, an unfinished atomic writer leaves the file alone
+    vector<ByteArray> chain = {ByteArray("ab"), ByteArray(), ByteArray("cde")};
+    WriteOptions write_opts;
+    write_opts.buffer_size = 4096;
+    write_opts.sync        = SyncPolicy::EveryBytes;
+    write_opts.sync_bytes  = 8192;
+    {
+        FileWriter writer("file_test.out", write_opts);
+        writer.write(ByteView(text)).write_chain(chain).write(ByteView(text));
+        CLS_Assert(writer.size() == 2 * text.size() + 5 && writer.close());
+    }
+    CLS_Assert(readFile("file_test.out") == text + "abcde" + text);
+    {
+        FileWriter writer("file_test.out");
+        writer.write(ByteView(text));
+    }
+    CLS_Assert(readFile("file_test.out").size() == 2 * text.size() + 5);
+    CLS_Assert(writeFile("file_test.out", chain) && readFile("file_test.out") == "abcde");
+
+    // CSV fields, quoted delimiters and newlines, typed conversion and parallel ranges
+    string csv_text = "id,name,score\r\n1,\"a,\"\"b\"\"\nc\",2.5\n\n-3,,1e3\n";
+    vector<string> csv_fields;
+    int64_t csv_int = 0;
+    double csv_real = 0;
+    auto csv_rows = CsvReader(ByteView(csv_text)).for_each([&](const CsvRow& row) {
+        for (size_t i = 0; i < row.size(); ++i) csv_fields.push_back(row.text(i));
+    });
+    CLS_Assert(csv_rows == 3 && csv_fields.size() == 9);
+    CLS_Assert(csv_fields[2] == "score" && csv_fields[4] == "a,\"b\"\nc" && csv_fields[7].empty());
+    CLS_Assert(parseNumber(ByteView(csv_fields[6]), csv_int) && csv_int == -3);
+    CLS_Assert(parseNumber(ByteView(csv_fields[8]), csv_real) && csv_real == 1000.0);
+    CLS_Assert(parseNumber(ByteView(csv_fields[5]), csv_real) && csv_real == 2.5);
+    CLS_Assert(!parseNumber(ByteView(csv_fields[2]), csv_int) && !parseNumber(ByteView(csv_fields[4]), csv_real));
+
+    string csv_big;
+    for (int i = 0; i < 200000; ++i) {
+        csv_big += to_string(i) + (i % 5 ? ",x\n" : ",\"x\ny\"\n");
+    }
+    writeFile("file_test.out", ByteView(csv_big));
+    ThreadPool csv_pool(4);
+    atomic<int64_t> csv_sum(0);
+    CsvReader csv_reader("file_test.out");
+    auto csv_count = csv_reader.for_each(csv_pool, [&](const CsvRow& row) {
+        int64_t value = 0;
+        if (row.size() == 2 && row.get(0, value)) csv_sum += value;
+    });
+    CLS_Assert(csv_count == 200000 && csv_sum == int64_t(199999) * 200000 / 2);
+    bool csv_thrown = false;
+    try {
+        string stop_at = "0";
+        csv_reader.for_each(csv_pool, [stop_at](const CsvRow& row) {
+            if (row[0] == ByteView(stop_at)) throw runtime_error("stop");
+        });
+    } catch (const runtime_error&) {
+        csv_thrown = true;
+    }
+    CLS_Assert(csv_thrown);
+
+    // Cached reads are shared until the file changes, least recently used entries go first
+    for (int use_inotify = 0; use_inotify < 2; ++use_inotify) {
+        CacheOptions cache_opts;
+        cache_opts.capacity    = 2 * text.size();
+        cache_opts.use_inotify = use_inotify != 0;
+        FileCache cache(cache_opts);
+        writeFile("file_test.out", ByteView(text));
+        auto cached = cache.get("file_test.out");
+        CLS_Assert(cached == cache.get("file_test.out") && *cached == ByteArray(text));
+        writeFile("file_test.out", ByteView(text + "!"));
+        CLS_Assert(cache.get("file_test.out")->size() == text.size() + 1 && cached->size() == text.size());
+        cache.get("file_test.txt");
+        auto cache_stats = cache.stats();
+        CLS_Assert(cache_stats.hits == 1 && cache_stats.misses == 3 && cache_stats.invalidations == 1);
+        CLS_Assert(cache_stats.evictions == 1 && cache_stats.entries == 1 && cache_stats.bytes == text.size());
+    }
+
+    remove("file_test.out");
+    remove("file_test.txt");
+    remove("file_test.idx");
+}
+
 int main(/*int argc, char* argv[]*/)
 EXCEPT_BEGIN
 #if CPP14_SUPPORT
@@ -174,6 +686,12 @@ EXCEPT_BEGIN
     CPUTimer timer;
 
     algTest();
+    hashTest();
+    compressTest();
+    byteIOTest();
+    chunkerTest();
+    bitsetTest();
+    fileTest();
 
     timer.delta();
 